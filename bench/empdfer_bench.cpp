@@ -0,0 +1,522 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Generates a synthetic corpus of images and times each stage of the
+// conversion on it, reporting the results as JSON on the standard output.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <paddlefish/paddlefish.h>
+
+#if defined(EMPDFER_LINUX) || defined(EMPDFER_MACOS) || \
+    defined(EMPDFER_FREEBSD)
+#include <sys/resource.h>
+#endif
+
+#ifdef EMPDFER_USE_PNG
+#include <png.h>
+#endif
+
+#include "create_page.h"
+#include "image.h"
+#include "jpeg_file.h"
+#include "json.h"
+#include "matrix.h"
+#include "pdf_writer.h"
+#include "pixels.h"
+#include "stats.h"
+#include "temp_file.h"
+
+#ifdef EMPDFER_USE_PNG
+#include "png_file.h"
+#endif
+
+namespace {
+struct CorpusOptions
+{
+    unsigned count = 20;
+    unsigned width = 2000;
+    unsigned height = 1500;
+    // Color channels, 1 or 3, without alpha.
+    unsigned components = 3;
+    // Bits per sample of the PNG files, 8 or 16. JPEG files are 8-bit.
+    unsigned bit_depth = 8;
+    bool alpha = false;
+    bool jpeg = true;
+    bool png = true;
+    int quality = 75;
+};
+
+struct Stage
+{
+    std::string name;
+    double seconds = 0.;
+    unsigned images = 0;
+    double megapixels = 0.;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Smooth gradients with some noise, so that images compress about as well
+// as scanned pages and photos do.
+std::vector<unsigned char> synthetic_samples(unsigned width, unsigned height,
+                                             unsigned channels,
+                                             unsigned bytes_per_sample,
+                                             unsigned seed)
+{
+    std::vector<unsigned char> data((size_t)width * height * channels *
+                                    bytes_per_sample);
+    unsigned state = seed * 2654435761u + 1;
+    size_t i = 0;
+
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                state = state * 1103515245u + 12345u;
+                double v = 128. +
+                    80. * std::sin(x * 0.011 * (c + 1) + seed) *
+                          std::cos(y * 0.007 - x * 0.002) +
+                    30. * std::sin((x + y) * 0.0013 * (c + 2)) +
+                    (double)((state >> 16) % 9) - 4.;
+                unsigned sample = (unsigned)std::fmin(std::fmax(v, 0.), 255.);
+
+                data[i++] = sample;
+                if (bytes_per_sample == 2)
+                    data[i++] = (state >> 8) & 0xff;
+            }
+
+    return data;
+}
+
+void write_file(const std::filesystem::path& path,
+                const std::vector<unsigned char>& bytes)
+{
+    std::ofstream f(path, std::ios_base::out|std::ios_base::binary);
+    f.write((const char*)bytes.data(), bytes.size());
+    if (!f)
+        throw std::runtime_error(path.string() + ": cannot write file");
+}
+
+#ifdef EMPDFER_USE_PNG
+void write_png(const std::filesystem::path& path, unsigned width,
+               unsigned height, unsigned channels, unsigned bit_depth,
+               bool alpha, const std::vector<unsigned char>& samples)
+{
+    FILE* fp = fopen(path.string().c_str(), "wb");
+    if (!fp)
+        throw std::runtime_error(path.string() + ": cannot write file");
+
+    png_structp png_ptr =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+    {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(fp);
+        throw std::runtime_error(path.string() + ": cannot encode PNG file");
+    }
+
+    int color_type = channels - (alpha ? 1 : 0) == 1 ?
+        (alpha ? PNG_COLOR_TYPE_GRAY_ALPHA : PNG_COLOR_TYPE_GRAY) :
+        (alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB);
+
+    png_init_io(png_ptr, fp);
+    png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, color_type,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    // 300 dpi.
+    png_set_pHYs(png_ptr, info_ptr, 11811, 11811, PNG_RESOLUTION_METER);
+    png_write_info(png_ptr, info_ptr);
+
+    size_t row_bytes = (size_t)width * channels * bit_depth / 8;
+    for (unsigned y = 0; y < height; ++y)
+        png_write_row(png_ptr,
+                      (png_const_bytep)samples.data() + y * row_bytes);
+
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(fp);
+}
+#endif
+
+std::vector<std::string> generate_corpus(const std::filesystem::path& dir,
+                                         const CorpusOptions& options)
+{
+    std::vector<std::string> files;
+    std::filesystem::create_directories(dir);
+
+    for (unsigned i = 0; i < options.count; ++i)
+    {
+        if (options.jpeg)
+        {
+            std::vector<unsigned char> samples = synthetic_samples(
+                options.width, options.height, options.components, 1, i);
+            std::filesystem::path path =
+                dir / ("image" + std::to_string(i) + ".jpg");
+            write_file(path, empdfer::create_jpeg(
+                samples.data(), options.width, options.height,
+                options.components,
+                options.components == 1 ? JCS_GRAYSCALE : JCS_RGB, 92));
+            files.push_back(path.string());
+        }
+
+#ifdef EMPDFER_USE_PNG
+        if (options.png)
+        {
+            unsigned channels = options.components + (options.alpha ? 1 : 0);
+            std::vector<unsigned char> samples = synthetic_samples(
+                options.width, options.height, channels,
+                options.bit_depth / 8, i);
+            std::filesystem::path path =
+                dir / ("image" + std::to_string(i) + ".png");
+            write_png(path, options.width, options.height, channels,
+                      options.bit_depth, options.alpha, samples);
+            files.push_back(path.string());
+        }
+#endif
+    }
+
+    return files;
+}
+
+// Largest resident set size of the process so far, in kilobytes.
+long peak_rss_kb()
+{
+#if defined(EMPDFER_LINUX) || defined(EMPDFER_FREEBSD)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#elif defined(EMPDFER_MACOS)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+#else
+    return -1;
+#endif
+}
+
+void print_json(std::ostream& out, const CorpusOptions& options,
+                const std::vector<std::string>& files,
+                const std::vector<Stage>& stages)
+{
+    out << "{\n  \"corpus\": {\"files\": " << files.size() <<
+        ", \"width\": " << options.width << ", \"height\": " <<
+        options.height << ", \"components\": " << options.components <<
+        ", \"bit_depth\": " << options.bit_depth << ", \"alpha\": " <<
+        (options.alpha ? "true" : "false") << ", \"quality\": " <<
+        options.quality << "},\n  \"stages\": [\n";
+
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        const Stage& s = stages[i];
+        out << "    {\"name\": " << empdfer::json_string(s.name) <<
+            ", \"seconds\": " << s.seconds << ", \"images\": " << s.images <<
+            ", \"megapixels_per_second\": " <<
+            (s.seconds > 0. ? s.megapixels / s.seconds : 0.) <<
+            ", \"pages_per_second\": " <<
+            (s.seconds > 0. ? s.images / s.seconds : 0.) << "}" <<
+            (i + 1 < stages.size() ? "," : "") << "\n";
+    }
+
+    out << "  ],\n  \"peak_rss_kb\": " << peak_rss_kb() << "\n}\n";
+}
+
+void usage(const std::string& name)
+{
+    std::cerr <<
+        "usage: " << name << " options\nwhere options are zero or more of:\n"
+        "-n, --count int    images of each format in the corpus (default: 20)\n"
+        "-w, --width int    width of the images in pixels (default: 2000)\n"
+        "-ht, --height int  height of the images in pixels (default: 1500)\n"
+        "-g, --gray         grayscale images (default: RGB)\n"
+        "-b, --bit-depth int bits per PNG sample, 8 or 16 (default: 8)\n"
+        "-a, --alpha        PNG images with an alpha channel\n"
+        "-f, --format fmt   jpeg, png or both (default: both)\n"
+        "-q, --quality int  quality of the encode stage (default: 75)\n"
+        "-d, --dir dir      keep the corpus in this directory (default: a\n"
+        "                   temporary directory, removed at the end)\n"
+        "-h, --help         show this message and exit\n";
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    CorpusOptions options;
+    std::string dir;
+
+    auto filename = std::filesystem::path(argv[0]).filename().string();
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(filename);
+            return -2;
+        }
+
+        if (!strcmp(argv[i], "-n") || !strcmp(argv[i], "--count"))
+            options.count = atoi(argv[++i]);
+
+        if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--width"))
+            options.width = atoi(argv[++i]);
+
+        if (!strcmp(argv[i], "-ht") || !strcmp(argv[i], "--height"))
+            options.height = atoi(argv[++i]);
+
+        if (!strcmp(argv[i], "-g") || !strcmp(argv[i], "--gray"))
+            options.components = 1;
+
+        if (!strcmp(argv[i], "-b") || !strcmp(argv[i], "--bit-depth"))
+            options.bit_depth = atoi(argv[++i]) == 16 ? 16 : 8;
+
+        if (!strcmp(argv[i], "-a") || !strcmp(argv[i], "--alpha"))
+            options.alpha = true;
+
+        if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--format"))
+        {
+            std::string format(argv[++i]);
+            options.jpeg = format != "png";
+            options.png = format != "jpeg";
+        }
+
+        if (!strcmp(argv[i], "-q") || !strcmp(argv[i], "--quality"))
+            options.quality = atoi(argv[++i]);
+
+        if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--dir"))
+            dir = std::string(argv[++i]);
+    }
+
+#ifndef EMPDFER_USE_PNG
+    options.png = false;
+#endif
+
+    bool keep = !dir.empty();
+    if (!keep)
+        dir = (std::filesystem::temp_directory_path() /
+               ("empdfer_bench_" + std::to_string(
+                   std::chrono::system_clock::now().time_since_epoch()
+                   .count()))).string();
+
+    std::vector<std::string> files = generate_corpus(dir, options);
+    std::vector<Stage> stages;
+    const double megapixels = options.width * (double)options.height / 1e6;
+
+    auto stage = [&](const std::string& name)
+    {
+        stages.push_back(Stage());
+        stages.back().name = name;
+        return stages.size() - 1;
+    };
+
+    empdfer::ImageOptions image_options;
+    image_options.quality = options.quality;
+
+    // Reading the headers.
+    std::vector<empdfer::ImageInfo> infos;
+    {
+        size_t s = stage("probe");
+        Clock::time_point start = Clock::now();
+        for (const auto& file : files)
+            infos.push_back(empdfer::probe_image(file));
+        stages[s].seconds = seconds_since(start);
+        stages[s].images = files.size();
+        stages[s].megapixels = files.size() * megapixels;
+    }
+
+    // Decoding JPEG files to pixels, and encoding them again as JPEG.
+    {
+        size_t decode = stage("jpeg_decode");
+        size_t encode = stage("encode");
+        for (const auto& file : files)
+        {
+            if (empdfer::file_type(file) != empdfer::JPEG)
+                continue;
+
+            Clock::time_point start = Clock::now();
+            empdfer::Pixels pixels = empdfer::decode_jpeg(file);
+            stages[decode].seconds += seconds_since(start);
+            stages[decode].images++;
+            stages[decode].megapixels += megapixels;
+
+            start = Clock::now();
+            std::vector<unsigned char> encoded =
+                empdfer::create_jpeg(pixels, options.quality);
+            stages[encode].seconds += seconds_since(start);
+            stages[encode].images++;
+            stages[encode].megapixels += megapixels;
+        }
+    }
+
+#ifdef EMPDFER_USE_PNG
+    // Decoding PNG files whole, as those to embed losslessly are. Only the
+    // time libpng takes counts, not that of splitting the alpha channel or
+    // of looking for gray images.
+    {
+        size_t s = stage("png_decode");
+        empdfer::ImageOptions lossless = image_options;
+        lossless.quality = -1;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (infos[i].type != empdfer::PNG)
+                continue;
+
+            empdfer::Stats stats;
+            {
+                empdfer::StatsScope scope(&stats);
+                empdfer::png_page(files[i], infos[i], lossless);
+            }
+            stages[s].seconds += stats.seconds[empdfer::STAGE_DECODE];
+            stages[s].images++;
+            stages[s].megapixels += megapixels;
+        }
+    }
+#endif
+
+    // Requantizing the coefficients, the path -q takes for JPEG files.
+    {
+        size_t s = stage("transcode");
+        for (const auto& file : files)
+        {
+            if (empdfer::file_type(file) != empdfer::JPEG)
+                continue;
+
+            Clock::time_point start = Clock::now();
+            std::vector<unsigned char> encoded;
+            empdfer::transcode_jpeg(file, 0, options.quality, encoded);
+            stages[s].seconds += seconds_since(start);
+            stages[s].images++;
+            stages[s].megapixels += megapixels;
+        }
+    }
+
+    // Separating the alpha channel, on synthetic interleaved samples.
+    {
+        size_t s = stage("alpha_split");
+        unsigned channels = options.components + 1;
+        unsigned bytes_per_sample = options.bit_depth / 8;
+        size_t pixels = (size_t)options.width * options.height;
+        std::vector<unsigned char> src = synthetic_samples(
+            options.width, options.height, channels, bytes_per_sample, 0);
+        std::vector<unsigned char> color(pixels * options.components *
+                                         bytes_per_sample);
+        std::vector<unsigned char> alpha(pixels * bytes_per_sample);
+
+        Clock::time_point start = Clock::now();
+        for (unsigned i = 0; i < options.count; ++i)
+            empdfer::split_alpha(src.data(), pixels, options.components,
+                                 bytes_per_sample, color.data(),
+                                 alpha.data());
+        stages[s].seconds = seconds_since(start);
+        stages[s].images = options.count;
+        stages[s].megapixels = options.count * megapixels;
+    }
+
+    // Computing the placement matrix, which is too fast to time once.
+    {
+        size_t s = stage("fill_matrix");
+        const unsigned calls = 1000000;
+        double matrix23[6];
+        // Keeps the calls from being optimized away.
+        volatile double sink = 0.;
+
+        Clock::time_point start = Clock::now();
+        for (unsigned i = 0; i < calls; ++i)
+        {
+            empdfer::fill_matrix(matrix23, 100. + i % 100, 150., 210., 297.,
+                                 i % 360, true);
+            sink = matrix23[4];
+        }
+        stages[s].seconds = seconds_since(start);
+        stages[s].images = calls;
+        (void)sink;
+    }
+
+    // Building whole documents, as the command line does by default and
+    // with --stream. By default the pages are built first and written
+    // with to_stream; together those two stages compare with "stream",
+    // which includes reading and encoding the images.
+    {
+        size_t build = stage("build_document");
+        size_t write = stage("to_stream");
+        Clock::time_point start = Clock::now();
+
+        paddlefish::DocumentPtr d(new paddlefish::Document());
+        for (size_t i = 0; i < files.size(); ++i)
+            d->push_back_page(empdfer::paddlefish_page(
+                empdfer::create_page(files[i], infos[i], image_options)));
+
+        stages[build].seconds = seconds_since(start);
+        stages[build].images = files.size();
+        stages[build].megapixels = files.size() * megapixels;
+
+        start = Clock::now();
+        std::ostringstream out;
+        d->to_stream(out);
+
+        stages[write].seconds = seconds_since(start);
+        stages[write].images = files.size();
+        stages[write].megapixels = files.size() * megapixels;
+        empdfer::remove_temp_files();
+    }
+
+    {
+        size_t s = stage("stream");
+        empdfer::ImageOptions stream_options = image_options;
+        stream_options.embed_flate = true;
+        Clock::time_point start = Clock::now();
+
+        std::ostringstream out;
+        empdfer::PdfWriter w(out);
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            empdfer::PageImage p =
+                empdfer::create_page(files[i], infos[i], stream_options);
+            empdfer::deflate_image(p.image);
+            w.write_page(p);
+        }
+        w.finish();
+
+        stages[s].seconds = seconds_since(start);
+        stages[s].images = files.size();
+        stages[s].megapixels = files.size() * megapixels;
+    }
+
+    print_json(std::cout, options, files, stages);
+
+    if (!keep)
+        std::filesystem::remove_all(dir);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "buffer_pool.h"
+
+#include <mutex>
+
+namespace {
+// Limits on what the pool keeps, so that a single huge image does not pin
+// its memory until the end of the run.
+const size_t max_buffers = 16;
+const size_t max_pooled_bytes = 256 * 1024 * 1024;
+
+std::mutex pool_mutex;
+std::vector<std::vector<unsigned char>> pool;
+size_t pooled_bytes = 0;
+} // namespace
+
+std::vector<unsigned char> empdfer::acquire_buffer(size_t size)
+{
+    std::vector<unsigned char> buffer;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        // Take the smallest buffer that fits. Growing a smaller one would
+        // copy its stale bytes to a new allocation anyway.
+        size_t best = pool.size();
+        for (size_t i = 0; i < pool.size(); ++i)
+            if (pool[i].capacity() >= size &&
+                (best == pool.size() ||
+                 pool[i].capacity() < pool[best].capacity()))
+                best = i;
+
+        if (best != pool.size())
+        {
+            buffer.swap(pool[best]);
+            pool.erase(pool.begin() + best);
+            pooled_bytes -= buffer.capacity();
+        }
+    }
+
+    // Pooled buffers keep the length they had, so only the bytes past it
+    // are zeroed. Callers overwrite the contents anyway.
+    buffer.resize(size);
+    return buffer;
+}
+
+void empdfer::release_buffer(std::vector<unsigned char>&& buffer)
+{
+    std::vector<unsigned char> b;
+    b.swap(buffer);
+
+    if (b.capacity() == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    if (pool.size() < max_buffers &&
+        pooled_bytes + b.capacity() <= max_pooled_bytes)
+    {
+        pooled_bytes += b.capacity();
+        pool.push_back(std::move(b));
+    }
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_BUFFER_POOL_H
+#define EMPDFER_BUFFER_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+namespace empdfer {
+
+// Pixel buffers are large and have similar sizes from one page to the next,
+// so instead of returning them to the allocator, they are kept for reuse.
+// Both functions can be called from any thread.
+
+// Returns a buffer of the given size, reusing the memory of a released
+// buffer when there is one large enough. The contents are unspecified.
+std::vector<unsigned char> acquire_buffer(size_t);
+
+// Gives the memory of a buffer back to the pool.
+void release_buffer(std::vector<unsigned char>&&);
+
+} // namespace empdfer
+
+#endif // EMPDFER_BUFFER_POOL_H
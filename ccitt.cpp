@@ -0,0 +1,241 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ccitt.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+struct Code
+{
+    unsigned short bits;
+    unsigned char length;
+};
+
+// Run length codes of T.4, shared by T.6. Terminating codes are for runs
+// of 0 to 63 pixels, make-up codes for multiples of 64 up to 1728, and the
+// extended ones, the same for both colors, up to 2560.
+const Code white_terminating[64] = {
+    {0x35, 8}, {0x07, 6}, {0x07, 4}, {0x08, 4}, {0x0b, 4}, {0x0c, 4},
+    {0x0e, 4}, {0x0f, 4}, {0x13, 5}, {0x14, 5}, {0x07, 5}, {0x08, 5},
+    {0x08, 6}, {0x03, 6}, {0x34, 6}, {0x35, 6}, {0x2a, 6}, {0x2b, 6},
+    {0x27, 7}, {0x0c, 7}, {0x08, 7}, {0x17, 7}, {0x03, 7}, {0x04, 7},
+    {0x28, 7}, {0x2b, 7}, {0x13, 7}, {0x24, 7}, {0x18, 7}, {0x02, 8},
+    {0x03, 8}, {0x1a, 8}, {0x1b, 8}, {0x12, 8}, {0x13, 8}, {0x14, 8},
+    {0x15, 8}, {0x16, 8}, {0x17, 8}, {0x28, 8}, {0x29, 8}, {0x2a, 8},
+    {0x2b, 8}, {0x2c, 8}, {0x2d, 8}, {0x04, 8}, {0x05, 8}, {0x0a, 8},
+    {0x0b, 8}, {0x52, 8}, {0x53, 8}, {0x54, 8}, {0x55, 8}, {0x24, 8},
+    {0x25, 8}, {0x58, 8}, {0x59, 8}, {0x5a, 8}, {0x5b, 8}, {0x4a, 8},
+    {0x4b, 8}, {0x32, 8}, {0x33, 8}, {0x34, 8}};
+
+const Code white_makeup[27] = {
+    {0x1b, 5}, {0x12, 5}, {0x17, 6}, {0x37, 7}, {0x36, 8}, {0x37, 8},
+    {0x64, 8}, {0x65, 8}, {0x68, 8}, {0x67, 8}, {0xcc, 9}, {0xcd, 9},
+    {0xd2, 9}, {0xd3, 9}, {0xd4, 9}, {0xd5, 9}, {0xd6, 9}, {0xd7, 9},
+    {0xd8, 9}, {0xd9, 9}, {0xda, 9}, {0xdb, 9}, {0x98, 9}, {0x99, 9},
+    {0x9a, 9}, {0x18, 6}, {0x9b, 9}};
+
+const Code black_terminating[64] = {
+    {0x37, 10}, {0x02, 3}, {0x03, 2}, {0x02, 2}, {0x03, 3}, {0x03, 4},
+    {0x02, 4}, {0x03, 5}, {0x05, 6}, {0x04, 6}, {0x04, 7}, {0x05, 7},
+    {0x07, 7}, {0x04, 8}, {0x07, 8}, {0x18, 9}, {0x17, 10}, {0x18, 10},
+    {0x08, 10}, {0x67, 11}, {0x68, 11}, {0x6c, 11}, {0x37, 11}, {0x28, 11},
+    {0x17, 11}, {0x18, 11}, {0xca, 12}, {0xcb, 12}, {0xcc, 12},
+    {0xcd, 12}, {0x68, 12}, {0x69, 12}, {0x6a, 12}, {0x6b, 12},
+    {0xd2, 12}, {0xd3, 12}, {0xd4, 12}, {0xd5, 12}, {0xd6, 12},
+    {0xd7, 12}, {0x6c, 12}, {0x6d, 12}, {0xda, 12}, {0xdb, 12},
+    {0x54, 12}, {0x55, 12}, {0x56, 12}, {0x57, 12}, {0x64, 12},
+    {0x65, 12}, {0x52, 12}, {0x53, 12}, {0x24, 12}, {0x37, 12},
+    {0x38, 12}, {0x27, 12}, {0x28, 12}, {0x58, 12}, {0x59, 12},
+    {0x2b, 12}, {0x2c, 12}, {0x5a, 12}, {0x66, 12}, {0x67, 12}};
+
+const Code black_makeup[27] = {
+    {0x0f, 10}, {0xc8, 12}, {0xc9, 12}, {0x5b, 12}, {0x33, 12},
+    {0x34, 12}, {0x35, 12}, {0x6c, 13}, {0x6d, 13}, {0x4a, 13},
+    {0x4b, 13}, {0x4c, 13}, {0x4d, 13}, {0x72, 13}, {0x73, 13},
+    {0x74, 13}, {0x75, 13}, {0x76, 13}, {0x77, 13}, {0x52, 13},
+    {0x53, 13}, {0x54, 13}, {0x55, 13}, {0x5a, 13}, {0x5b, 13},
+    {0x64, 13}, {0x65, 13}};
+
+const Code extended_makeup[13] = {
+    {0x08, 11}, {0x0c, 11}, {0x0d, 11}, {0x12, 12}, {0x13, 12},
+    {0x14, 12}, {0x15, 12}, {0x16, 12}, {0x17, 12}, {0x1c, 12},
+    {0x1d, 12}, {0x1e, 12}, {0x1f, 12}};
+
+// Mode codes of T.6. The vertical ones are indexed by a1 - b1 + 3.
+const Code pass_code = {0x1, 4};
+const Code horizontal_code = {0x1, 3};
+const Code vertical_codes[7] = {
+    {0x02, 7}, {0x02, 6}, {0x02, 3}, {0x1, 1}, {0x03, 3}, {0x03, 6},
+    {0x03, 7}};
+const Code eol_code = {0x1, 12};
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) :
+        out_(out), buffer_(0), count_(0) {}
+
+    void put(Code code)
+    {
+        buffer_ = buffer_ << code.length | code.bits;
+        count_ += code.length;
+        while (count_ >= 8)
+        {
+            count_ -= 8;
+            out_.push_back((buffer_ >> count_) & 0xff);
+        }
+    }
+
+    // Pads the last byte with zeros.
+    void flush()
+    {
+        if (count_ > 0)
+            out_.push_back((buffer_ << (8 - count_)) & 0xff);
+        count_ = 0;
+    }
+
+private:
+    std::vector<unsigned char>& out_;
+    uint32_t buffer_;
+    unsigned count_;
+};
+
+void put_run(BitWriter& w, unsigned run, bool black)
+{
+    const Code* terminating = black ? black_terminating : white_terminating;
+    const Code* makeup = black ? black_makeup : white_makeup;
+
+    // Longer runs are split in runs of 2560 followed by a shorter one.
+    while (run >= 2560 + 64)
+    {
+        w.put(extended_makeup[12]);
+        run -= 2560;
+    }
+    if (run >= 64)
+    {
+        unsigned m = run / 64;
+        w.put(m <= 27 ? makeup[m - 1] : extended_makeup[m - 28]);
+        run %= 64;
+    }
+    w.put(terminating[run]);
+}
+
+// Fills in the changing elements of a row: the positions of the pixels
+// whose color differs from the one to their left, taking white for the
+// one left of the row. They alternate between white to black (even
+// indices) and black to white (odd ones). Three elements at width follow,
+// so that the coder never looks past the end.
+void changing_elements(const unsigned char* row, unsigned width,
+                       std::vector<unsigned>& c)
+{
+    c.clear();
+    bool black = false;
+    unsigned x = 0;
+    while (x < width)
+    {
+        unsigned char byte = row[x / 8];
+
+        // Skip whole bytes of the current color.
+        if (x % 8 == 0 && x + 8 <= width && byte == (black ? 0x00 : 0xff))
+        {
+            x += 8;
+            continue;
+        }
+
+        bool b = !(byte & (0x80 >> (x % 8)));
+        if (b != black)
+        {
+            c.push_back(x);
+            black = b;
+        }
+        ++x;
+    }
+    c.insert(c.end(), 3, width);
+}
+} // namespace
+
+std::vector<unsigned char> empdfer::encode_g4(const unsigned char* bits,
+                                              unsigned width,
+                                              unsigned height)
+{
+    std::vector<unsigned char> out;
+    BitWriter w(out);
+
+    size_t row_bytes = (width + 7) / 8;
+
+    // The line above the first one is white.
+    std::vector<unsigned> reference(3, width);
+    std::vector<unsigned> coding;
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+        changing_elements(bits + y * row_bytes, width, coding);
+
+        // a0 starts on an imaginary white pixel left of the row.
+        long a0 = -1;
+        bool black = false;
+        size_t i = 0, j = 0;
+        while (a0 < (long)width)
+        {
+            // a1 is the next changing element on the coding line, and b1
+            // the next one on the reference line that changes to the
+            // color opposite to that of a0. b1 can move left after a
+            // vertical mode, by one element at most.
+            while (coding[i] <= a0)
+                ++i;
+            if (j > 0)
+                --j;
+            while (reference[j] <= a0 || (j % 2 == 0) == black)
+                ++j;
+
+            long a1 = coding[i];
+            long b1 = reference[j];
+            long b2 = reference[j + 1];
+
+            if (b2 < a1)
+            {
+                w.put(pass_code);
+                a0 = b2;
+            }
+            else if (a1 - b1 >= -3 && a1 - b1 <= 3)
+            {
+                w.put(vertical_codes[a1 - b1 + 3]);
+                a0 = a1;
+                black = !black;
+            }
+            else
+            {
+                long a2 = coding[i + 1];
+                w.put(horizontal_code);
+                put_run(w, a1 - std::max(a0, 0L), black);
+                put_run(w, a2 - a1, !black);
+                a0 = a2;
+            }
+        }
+
+        reference.swap(coding);
+    }
+
+    // End of facsimile block.
+    w.put(eol_code);
+    w.put(eol_code);
+    w.flush();
+
+    return out;
+}
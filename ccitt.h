@@ -0,0 +1,34 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_CCITT_H
+#define EMPDFER_CCITT_H
+
+#include <vector>
+
+namespace empdfer {
+
+// Encodes a black and white image with CCITT Group 4 (ITU-T T.6), as read
+// by the CCITTFaxDecode filter of PDF with K -1 and the default BlackIs1
+// false. Rows are packed at 1 bit per pixel, 0 for black and 1 for white,
+// each row starting on a new byte. The data ends with an EOFB.
+std::vector<unsigned char> encode_g4(const unsigned char* bits,
+                                     unsigned width, unsigned height);
+
+} // namespace empdfer
+
+#endif // EMPDFER_CCITT_H
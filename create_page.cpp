@@ -15,41 +15,231 @@
 // You should have received a copy of the GNU General Public License
 // along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <exception>
 #include <iostream>
 
 #include "create_page.h"
 #include "file_type.h"
 #include "jpeg_file.h"
+#include "stats.h"
+#include "temp_file.h"
 #ifdef EMPDFER_USE_PNG
 #include "png_file.h"
 #endif
 
-paddlefish::PagePtr empdfer::create_page(const std::string& input_file,
-                                         double page_x_mm, double page_y_mm,
-                                         double img_x_mm, double img_y_mm,
-                                         int quality, double rotation,
-                                         bool shrink)
+namespace {
+// Typical size of a JPEG image saved with the given quality, relative to
+// the same image saved with quality 75, measured with libjpeg.
+double relative_jpeg_size(int quality)
 {
-    switch (file_type(input_file))
-    {
-        case empdfer::FileType::JPEG:
-            return empdfer::jpeg_page(input_file, page_x_mm, page_y_mm,
-                                      img_x_mm, img_y_mm, quality, rotation,
-                                      shrink);
-            break;
-        case empdfer::FileType::PNG:
+    const double sizes[] = {0.2, 0.35, 0.45, 0.53, 0.6, 0.67, 0.8, 0.94,
+                            1.1, 1.55, 3.4};
+    if (quality == 75)
+        return 1.;
+
+    // Interpolate between multiples of 10.
+    quality = std::clamp(quality, 0, 100);
+    unsigned i = quality / 10;
+    if (i == 10)
+        return sizes[10];
+    double t = (quality - 10. * i) / 10.;
+    return sizes[i] * (1. - t) + sizes[i + 1] * t;
+}
+
+// What reads each type of file. Another format needs its signature in
+// file_type() and an entry here.
+struct Decoder
+{
+    empdfer::FileType type;
+    empdfer::ImageInfo (*probe)(const empdfer::Input&);
+    empdfer::PageImage (*page)(const empdfer::Input&,
+                               const empdfer::ImageInfo&,
+                               const empdfer::ImageOptions&);
+};
+
+const Decoder decoders[] =
+{
+    {empdfer::FileType::JPEG, empdfer::probe_jpeg, empdfer::jpeg_page},
 #ifdef EMPDFER_USE_PNG
-            return empdfer::png_page(input_file, page_x_mm, page_y_mm,
-                                     img_x_mm, img_y_mm, quality, rotation,
-                                     shrink);
-#else
-            throw std::runtime_error(input_file +
-                ": PNG is not supported, compile with libpng");
+    {empdfer::FileType::PNG, empdfer::probe_png, empdfer::png_page},
 #endif
+};
+
+const Decoder* decoder(empdfer::FileType type)
+{
+    for (const Decoder& d : decoders)
+        if (d.type == type)
+            return &d;
+    return NULL;
+}
+} // namespace
+
+empdfer::ImageInfo empdfer::probe_image(const Input& input)
+{
+    StageTimer timer(STAGE_PROBE);
+
+    FileType type = file_type(input);
+    if (const Decoder* d = decoder(type))
+        return d->probe(input);
+
+#ifndef EMPDFER_USE_PNG
+    if (type == empdfer::FileType::PNG)
+        throw std::runtime_error(input.name +
+            ": PNG is not supported, compile with libpng");
+#endif
+    throw std::runtime_error(input.name + ": Unknown file type");
+}
+
+empdfer::PageImage empdfer::create_page(const Input& input,
+                                        const ImageInfo& info,
+                                        const ImageOptions& options)
+{
+    if (const Decoder* d = decoder(info.type))
+        return d->page(input, info, options);
+
+    throw std::runtime_error(input.name + ": Unknown file type");
+}
+
+empdfer::PageImage empdfer::create_page(const Input& input,
+                                        const ImageOptions& options)
+{
+    Input mapped = map_input(input);
+    return create_page(mapped, probe_image(mapped), options);
+}
+
+empdfer::PageImage empdfer::plan_page(const ImageInfo& info,
+                                      const ImageOptions& options,
+                                      uintmax_t& estimated_bytes)
+{
+    PageImage p;
+    empdfer::layout(p, info.width, info.height, info.x_density_dpmm,
+                    info.y_density_dpmm, options);
+
+    Image& image = p.image;
+    image.width = info.width;
+    image.height = info.height;
+    image.components = info.components;
+    image.bits_per_component = info.bits_per_component;
+    image.color_space = info.color_space;
+
+    // Encoded sizes are guessed from the compressed bytes per pixel of the
+    // input, or from a typical JPEG ratio when there is nothing better.
+    double bytes_per_pixel = (double)info.file_size /
+                             ((double)info.width * info.height);
+    double raw_bytes_per_pixel = info.components *
+                                 info.bits_per_component / 8.;
+    int source_quality = info.quality != -1 ? info.quality : 75;
+    int quality = options.quality != -1 ? options.quality : source_quality;
+
+    if (info.type == JPEG)
+    {
+        image.filter = FILTER_DCT;
+
+        unsigned target_x = info.width, target_y = info.height;
+        if (info.components != 4)
+            empdfer::max_dpi_size(p, info.width, info.height,
+                                  options.max_dpi, target_x, target_y);
+
+        if (target_x == info.width && target_y == info.height &&
+            options.quality == -1)
+            estimated_bytes = info.file_size;
+        else
+        {
+            image.width = target_x;
+            image.height = target_y;
+            estimated_bytes = bytes_per_pixel * target_x * target_y *
+                              relative_jpeg_size(quality) /
+                              relative_jpeg_size(source_quality);
+        }
+
+        // Assume rotating the image works, which is always the case when
+        // it is encoded again.
+        if (options.upright && empdfer::quarter_turns(options.rotation) % 2)
+            std::swap(image.width, image.height);
+    }
+    else if (options.quality != -1)
+    {
+        image.filter = FILTER_DCT;
+        image.bits_per_component = 8;
+        estimated_bytes = info.width * (double)info.height *
+                          info.components / 10. *
+                          relative_jpeg_size(quality);
+    }
+    else if (options.embed_flate && !info.indexed && !info.alpha &&
+             !info.interlaced)
+    {
+        // The compressed data of the file is embedded as it is.
+        image.filter = FILTER_FLATE;
+        estimated_bytes = info.file_size;
+    }
+    else
+    {
+        // Once decoded, count the samples as they are. This is at most what
+        // compressing them again takes.
+        if (options.embed_flate)
+            image.filter = FILTER_FLATE;
+        estimated_bytes = raw_bytes_per_pixel * info.width * info.height;
+        if (info.alpha)
+            estimated_bytes += info.bits_per_component / 8. * info.width *
+                               info.height;
+    }
+
+    // Black and white images take at most a bit per pixel.
+    if (options.threshold >= 0 && !(info.type == JPEG && info.components == 4))
+    {
+        image.components = 1;
+        image.bits_per_component = 1;
+        image.color_space = DEVICE_GRAY;
+        image.filter = options.embed_flate ? FILTER_CCITT : FILTER_NONE;
+        estimated_bytes = (image.width + 7) / 8 * (double)image.height;
+    }
+
+    return p;
+}
+
+paddlefish::PagePtr empdfer::paddlefish_page(PageImage&& page)
+{
+    // paddlefish may keep pointers to the image bytes until the document
+    // is written, so the page owns them.
+    auto image = std::make_shared<Image>(std::move(page.image));
+    paddlefish::PagePtr p(new paddlefish::Page(),
+                          [image](paddlefish::Page* p) { delete p; });
+
+    // Set the page size.
+    p->set_mediabox(0, 0, MILIMETERS(page.page_x_mm),
+                    MILIMETERS(page.page_y_mm));
+
+    int color_space = image->color_space == DEVICE_GRAY ?
+                      COLORSPACE_DEVICEGRAY : COLORSPACE_DEVICERGB;
+
+    switch (image->filter)
+    {
+        case FILTER_DCT:
+            // paddlefish embeds JPEG images from a file, so bytes encoded
+            // in memory are written once to a private temporary file.
+            // Mapped files are given by name.
+            p->add_jpeg_image(image->source.empty() ?
+                              empdfer::temp_file(image->data, "image.jpg") :
+                              image->source.in_memory() &&
+                              !image->source.mapped() ?
+                              empdfer::temp_file(image->source, "image.jpg") :
+                              image->source.name,
+                              image->width, image->height, page.matrix23,
+                              color_space);
+            break;
+        case FILTER_NONE:
+            p->add_image_bytes(image->data.data(),
+                               image->mask ? image->mask->data.data() : NULL,
+                               image->bits_per_component, image->components,
+                               image->width, image->height, page.matrix23,
+                               color_space, true);
             break;
         default:
-            throw std::runtime_error(input_file + ": Unknown file type");
+            throw std::runtime_error("image encoding not supported by "
+                                     "paddlefish");
             break;
     }
+
+    return p;
 }
@@ -18,14 +18,32 @@
 #ifndef EMPDFER_CREATE_PAGE_H
 #define EMPDFER_CREATE_PAGE_H
 
+#include <cstdint>
 #include <string>
 
 #include <paddlefish/paddlefish.h>
 
+#include "image.h"
+
 namespace empdfer {
 
-paddlefish::PagePtr create_page(const std::string&, double, double, double,
-                                double, int, double, bool);
+// Reads the header of the input image, without decoding it.
+ImageInfo probe_image(const Input&);
+
+// Reads the input image and lays it out on a page.
+PageImage create_page(const Input&, const ImageInfo&, const ImageOptions&);
+
+// Same, mapping the file of the input for both steps.
+PageImage create_page(const Input&, const ImageOptions&);
+
+// Lays out the image as create_page() would, without reading it. The image
+// of the page has the size and encoding it would be embedded with, but no
+// data. Sets estimated_bytes to a guess of the size of its data.
+PageImage plan_page(const ImageInfo&, const ImageOptions&,
+                    uintmax_t& estimated_bytes);
+
+// Converts a page to a paddlefish page.
+paddlefish::PagePtr paddlefish_page(PageImage&&);
 
 } // namespace empdfer
 
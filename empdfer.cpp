@@ -15,26 +15,56 @@
 // You should have received a copy of the GNU General Public License
 // along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <chrono>
+#include <cmath>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include <paddlefish/paddlefish.h>
 
 #include "create_page.h"
+#include "image_cache.h"
+#include "manifest.h"
+#include "pdf_writer.h"
+#include "serve.h"
+#include "stats.h"
+#include "target_size.h"
+#include "temp_file.h"
+#include "thread_pool.h"
 #include "version.h"
 
-int main(int argc, char *argv[])
+namespace {
+int run(int argc, char *argv[])
 {
   std::vector<std::string> input_files;
   std::string output_file;
   std::vector<double> img_x_mm, img_y_mm, rotation;
+  std::vector<int> threshold;
   int quality = -1;
+  int compression = -1;
+  int gray_tolerance = -1;
+  double target_size_mb = -1.;
   bool shrink = true;
+  unsigned jobs = 1;
+  bool stream = false;
+  int max_dpi = -1;
+  std::string cache_dir;
+  long cache_size_mb = 1024;
+  bool dry_run = false;
+  bool upright = false;
+  bool stats = false;
+  std::string stats_file;
+  bool serve = false;
+  std::string socket_path;
+  std::string manifest_file;
 
   // Default page size.
   double page_x_mm = 210.;
@@ -54,10 +84,50 @@ int main(int argc, char *argv[])
         "-y, --size-y mm    output height of the last specified image\n"
         "-ns, --no-shrink   do not shrink the image to fit the page\n"
         "-o, --output file  output file name (if `-` or omitted, use stdout)\n"
+        "-s, --stream       write each page as soon as it is ready, without\n"
+        "                   keeping the whole document in memory\n"
         "-px, --page-x mm   width of the output pages (default: " << page_x_mm << ")\n"
         "-py, --page-y mm   height of the output pages (default: " << page_y_mm << ")\n"
         "-q, --quality int  output image quality (default: retain input quality)\n"
+        "--target-size MB   encode all images again as JPEG, with the highest\n"
+        "                   quality, up to the one given with -q or 95, that\n"
+        "                   keeps the output within this size\n"
+        "-z, --compression int\n"
+        "                   zlib compression level, from 0 to 9, of lossless\n"
+        "                   images compressed by empdfer with -s (default: 6)\n"
+        "-g, --gray int     embed images whose channels differ by at most this\n"
+        "                   much as gray, and gray ones within this much of\n"
+        "                   black or white with 1 bit per pixel; lossless\n"
+        "                   images are decoded to check (default: off)\n"
         "-r, --rotation deg counter-clockwise rotation of the image (default: 0)\n"
+        "-t, --threshold int\n"
+        "                   make the last specified image black and white, with\n"
+        "                   the samples darker than this level, from 0 to 255,\n"
+        "                   black\n"
+        "-u, --upright      apply rotations by multiples of 90 degrees to JPEG\n"
+        "                   images themselves, losslessly when possible\n"
+        "-md, --max-dpi int scale JPEG images down to this resolution once\n"
+        "                   placed on the page (default: keep all pixels)\n"
+        "-c, --cache dir    keep recompressed images in this directory, to reuse\n"
+        "                   them in later runs\n"
+        "-cs, --cache-size MB\n"
+        "                   maximum size of the cache (default: " <<
+        cache_size_mb << ")\n"
+        "-n, --dry-run      print the layout of each image and the expected size\n"
+        "                   of the output, without writing it\n"
+        "--stats=json       write the time spent in each stage and the bytes and\n"
+        "                   pixels processed for each page to stderr, as JSON\n"
+        "--stats-file file  write those statistics to this file instead\n"
+        "-j, --jobs int     number of images to process in parallel (default: 1,\n"
+        "                   0 means one per available core)\n"
+        "--serve            keep running, reading jobs as JSON lines from stdin\n"
+        "                   and answering each with a JSON line on stdout; the\n"
+        "                   other options are the defaults of the jobs\n"
+        "--socket path      serve jobs the same way to clients connecting to a\n"
+        "                   Unix domain socket\n"
+        "--manifest file    build the documents described in this file, one job\n"
+        "                   per line as in --serve, each naming its output (if\n"
+        "                   `-`, read them from stdin)\n"
         "-h, --help         show this message and exit\n"
         "-v, --version      show version information and exit\n"
         "Sizes are specified in millimeters\n";
@@ -78,6 +148,7 @@ int main(int argc, char *argv[])
       img_x_mm.push_back(-1.);
       img_y_mm.push_back(-1.);
       rotation.push_back(0.);
+      threshold.push_back(-1);
     }
 
     if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
@@ -85,6 +156,11 @@ int main(int argc, char *argv[])
       output_file = std::string(argv[++i]);
     }
 
+    if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--stream"))
+    {
+      stream = true;
+    }
+
     if (!strcmp(argv[i], "-x") || !strcmp(argv[i], "--size-x"))
     {
       img_x_mm[img_x_mm.size() - 1] = atof(argv[++i]);
@@ -115,10 +191,170 @@ int main(int argc, char *argv[])
       quality = atoi(argv[++i]);
     }
 
+    if (!strcmp(argv[i], "-z") || !strcmp(argv[i], "--compression"))
+    {
+      compression = atoi(argv[++i]);
+
+      if (compression < 0 || compression > 9)
+      {
+        std::cerr << "The compression level must be from 0 to 9, use \"" <<
+          filename << " --help\"." << std::endl;
+
+        return -4;
+      }
+    }
+
+    if (!strcmp(argv[i], "-g") || !strcmp(argv[i], "--gray"))
+    {
+      gray_tolerance = atoi(argv[++i]);
+
+      if (gray_tolerance < 0 || gray_tolerance > 255)
+      {
+        std::cerr << "The gray tolerance must be from 0 to 255, use \"" <<
+          filename << " --help\"." << std::endl;
+
+        return -4;
+      }
+    }
+
+    if (!strcmp(argv[i], "--target-size"))
+    {
+      target_size_mb = atof(argv[++i]);
+    }
+
     if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--rotation"))
     {
       rotation[rotation.size() - 1] = atoi(argv[++i]);
     }
+
+    if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threshold"))
+    {
+      threshold[threshold.size() - 1] = atoi(argv[++i]);
+
+      if (threshold.back() < 0 || threshold.back() > 255)
+      {
+        std::cerr << "The threshold must be from 0 to 255, use \"" <<
+          filename << " --help\"." << std::endl;
+
+        return -4;
+      }
+    }
+
+    if (!strcmp(argv[i], "-u") || !strcmp(argv[i], "--upright"))
+    {
+      upright = true;
+    }
+
+    if (!strcmp(argv[i], "-md") || !strcmp(argv[i], "--max-dpi"))
+    {
+      max_dpi = atoi(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cache"))
+    {
+      cache_dir = std::string(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], "-cs") || !strcmp(argv[i], "--cache-size"))
+    {
+      cache_size_mb = atol(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], "-n") || !strcmp(argv[i], "--dry-run"))
+    {
+      dry_run = true;
+    }
+
+    if (!strcmp(argv[i], "--stats=json"))
+    {
+      stats = true;
+    }
+
+    if (!strcmp(argv[i], "--stats-file"))
+    {
+      stats = true;
+      stats_file = std::string(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs"))
+    {
+      int j = atoi(argv[++i]);
+      jobs = j > 0 ? j : empdfer::hardware_jobs();
+    }
+
+    if (!strcmp(argv[i], "--serve"))
+    {
+      serve = true;
+    }
+
+    if (!strcmp(argv[i], "--socket"))
+    {
+      serve = true;
+      socket_path = std::string(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], "--manifest"))
+    {
+      manifest_file = std::string(argv[++i]);
+    }
+  }
+
+  // Options that apply to every image.
+  empdfer::ImageOptions defaults;
+  defaults.page_x_mm = page_x_mm;
+  defaults.page_y_mm = page_y_mm;
+  defaults.quality = quality;
+  defaults.compression = compression;
+  defaults.gray_tolerance = gray_tolerance;
+  defaults.shrink = shrink;
+  defaults.max_dpi = max_dpi;
+  defaults.cache_dir = cache_dir;
+  defaults.upright = upright;
+
+  if (serve)
+  {
+    // The workers and the codecs they set up stay around for all the jobs.
+    std::unique_ptr<empdfer::ThreadPool> pool;
+    if (jobs > 1)
+      pool.reset(new empdfer::ThreadPool(jobs));
+
+    if (socket_path.empty())
+    {
+      std::ios_base::sync_with_stdio(false);
+      empdfer::serve(std::cin, std::cout, defaults, pool.get());
+    }
+    else
+      empdfer::serve_socket(socket_path, defaults, pool.get());
+
+    if (!cache_dir.empty())
+      empdfer::trim_cache(cache_dir, (uintmax_t)cache_size_mb * 1024 * 1024);
+
+    return 0;
+  }
+
+  if (!manifest_file.empty())
+  {
+    std::unique_ptr<empdfer::ThreadPool> pool;
+    if (jobs > 1)
+      pool.reset(new empdfer::ThreadPool(jobs));
+
+    std::ifstream mf;
+    if (manifest_file != "-")
+    {
+      mf.open(manifest_file);
+      if (!mf)
+        throw std::runtime_error(manifest_file + ": can't open manifest file");
+    }
+
+    size_t failed = empdfer::run_manifest(mf.is_open() ? mf : std::cin,
+                                          defaults, pool.get(), std::cerr);
+
+    empdfer::remove_temp_files();
+
+    if (!cache_dir.empty())
+      empdfer::trim_cache(cache_dir, (uintmax_t)cache_size_mb * 1024 * 1024);
+
+    return failed ? -5 : 0;
   }
 
   if (input_files.empty())
@@ -128,25 +364,228 @@ int main(int argc, char *argv[])
     return -4;
   }
 
-  paddlefish::DocumentPtr d(new paddlefish::Document());
+  // A single page can use the workers too, to encode its image in bands.
+  std::unique_ptr<empdfer::ThreadPool> pool;
+  if (jobs > 1)
+    pool.reset(new empdfer::ThreadPool(jobs));
+
+  auto options = [&](size_t i)
+  {
+    empdfer::ImageOptions o = defaults;
+    o.pool = pool.get();
+    o.img_x_mm = img_x_mm[i];
+    o.img_y_mm = img_y_mm[i];
+    o.rotation = rotation[i];
+    o.threshold = threshold[i];
+    o.embed_flate = stream;
+    if (target_size_mb > 0.)
+    {
+      o.quality = quality != -1 ? quality : 95;
+      o.defer_jpeg = true;
+    }
+    return o;
+  };
+
+  // Work on each page is recorded in its own entry, the rest in document.
+  auto start = std::chrono::steady_clock::now();
+  std::vector<empdfer::Stats> page_stats(stats ? input_files.size() : 0);
+  empdfer::Stats document_stats;
+  auto page_scope = [&](size_t i)
+  {
+    return stats ? &page_stats[i] : (empdfer::Stats*)NULL;
+  };
+  empdfer::StatsScope document_scope(stats ? &document_stats : NULL);
+
+  auto write_stats = [&]()
+  {
+    if (!stats)
+      return;
+
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    std::ofstream sf;
+    if (!stats_file.empty())
+      sf.open(stats_file, std::ios_base::out);
+    empdfer::write_stats_json(sf.is_open() ? sf : std::cerr, input_files,
+                              page_stats, document_stats, seconds);
+  };
+
+  // Read the headers of all the inputs first, so that unreadable files are
+  // found before doing any heavy work.
+  // Each file is mapped once, and read from there until its page is done.
+  std::vector<empdfer::ImageInfo> infos;
+  infos.reserve(input_files.size());
+  std::vector<empdfer::Input> inputs(input_files.size());
+  empdfer::ordered_for_each(pool.get(), input_files.size(),
+                            input_files.size(),
+    [&](size_t i)
+    {
+      empdfer::StatsScope scope(page_scope(i));
+      inputs[i] = empdfer::map_input(input_files[i]);
+      return empdfer::probe_image(inputs[i]);
+    },
+    [&](empdfer::ImageInfo&& info) { infos.push_back(info); });
+
+  if (dry_run)
+  {
+    // Roughly what each page and the document structure take.
+    const uintmax_t page_bytes = 300, document_bytes = 200;
+    uintmax_t total = document_bytes;
+
+    for (size_t i = 0; i < input_files.size(); ++i)
+    {
+      uintmax_t bytes;
+      empdfer::PageImage p = empdfer::plan_page(infos[i], options(i), bytes);
+      total += bytes + page_bytes;
+
+      const empdfer::ImageInfo& info = infos[i];
+      const empdfer::Image& image = p.image;
+      double placed_x_mm = std::hypot(p.matrix23[0], p.matrix23[1]) * 25.4 / 72.;
+      double placed_y_mm = std::hypot(p.matrix23[2], p.matrix23[3]) * 25.4 / 72.;
+
+      std::cout << input_files[i] << ": " << info.width << "x" <<
+        info.height << " pixels, " << info.components << " components, " <<
+        info.bits_per_component << " bits" << (info.alpha ? ", alpha" : "") <<
+        "; placed at " << placed_x_mm << "x" << placed_y_mm << " mm on a " <<
+        p.page_x_mm << "x" << p.page_y_mm << " mm page; embedded as " <<
+        image.width << "x" << image.height << " " <<
+        (image.filter == empdfer::FILTER_DCT ? "JPEG" :
+         image.filter == empdfer::FILTER_FLATE ? "Flate" :
+         image.filter == empdfer::FILTER_CCITT ? "CCITT G4" : "raw") <<
+        ", about " << bytes << " bytes" << std::endl;
+    }
+
+    std::cout << "Expected output size: about " << total << " bytes" <<
+      std::endl;
+
+    write_stats();
+
+    return 0;
+  }
+
+  // Build all the pages first, keeping their pixels, to find the quality
+  // that makes them fit.
+  std::vector<empdfer::PageImage> fitted;
+  if (target_size_mb > 0.)
+  {
+    fitted.reserve(input_files.size());
+    empdfer::ordered_for_each(pool.get(), input_files.size(),
+                              input_files.size(),
+      [&](size_t i)
+      {
+        empdfer::StatsScope scope(page_scope(i));
+        empdfer::PageImage p = empdfer::create_page(inputs[i], infos[i],
+                                                    options(i));
+        inputs[i] = empdfer::Input();
+        // Images that are not JPEG, like bi-level ones, count with the
+        // size they will be written with.
+        if (stream)
+          empdfer::deflate_image(p.image, options(i));
+        return p;
+      },
+      [&](empdfer::PageImage&& p) { fitted.push_back(std::move(p)); });
 
-  for (size_t i = 0; i < input_files.size(); ++i)
-    d->push_back_page(empdfer::create_page(input_files[i], page_x_mm, page_y_mm,
-                                           img_x_mm[i], img_y_mm[i], quality,
-                                           rotation[i], shrink));
+    uintmax_t budget = target_size_mb * 1024 * 1024, bytes;
+    int q = empdfer::fit_quality(fitted, budget, options(0).quality,
+                                 pool.get(), bytes);
+    if (bytes > budget)
+      std::cerr << "The output does not fit in " << target_size_mb <<
+        " MB, even with quality " << q << "." << std::endl;
+  }
 
-  if (output_file.empty() || output_file == "-")
+  std::ofstream f;
+  if (!output_file.empty() && output_file != "-")
+    f.open(output_file, std::ios_base::out|std::ios_base::binary);
+  std::ostream& target = f.is_open() ? f : std::cout;
+
+  // Count the bytes of the output only when they are reported.
+  empdfer::CountingStreamBuf counting(target.rdbuf());
+  std::ostream counted(&counting);
+  std::ostream& out = stats ? counted : target;
+
+  if (stream)
   {
-    d->to_stream(std::cout);
+    // Keep only a few pages in flight, so that memory usage depends on the
+    // size of the pages and not on their number.
+    empdfer::PdfWriter w(out);
+    size_t written = 0;
+
+    empdfer::ordered_for_each(pool.get(), input_files.size(), 2 * jobs,
+      [&](size_t i)
+      {
+        empdfer::StatsScope scope(page_scope(i));
+        empdfer::PageImage p = fitted.empty() ?
+          empdfer::create_page(inputs[i], infos[i], options(i)) :
+          std::move(fitted[i]);
+        // Images embedded as they are keep their own view of the file.
+        inputs[i] = empdfer::Input();
+        empdfer::deflate_image(p.image, options(i));
+        // Hashing here keeps it off the thread writing the output.
+        empdfer::digest_image(p.image);
+        return p;
+      },
+      [&](empdfer::PageImage&& p)
+      {
+        empdfer::StatsScope scope(page_scope(written++));
+        empdfer::StageTimer timer(empdfer::STAGE_WRITE);
+        w.write_page(p);
+      });
+
+    empdfer::StageTimer timer(empdfer::STAGE_WRITE);
+    w.finish();
   }
   else
   {
-    std::ofstream f(output_file, std::ios_base::out|std::ios_base::binary);
-    d->to_stream(f);
-    f.close();
+    // Build the pages on the workers, but add them to the document in the
+    // same order they were given in the command line.
+    paddlefish::DocumentPtr d(new paddlefish::Document());
+
+    empdfer::ordered_for_each(pool.get(), input_files.size(),
+                              input_files.size(),
+      [&](size_t i)
+      {
+        empdfer::StatsScope scope(page_scope(i));
+        empdfer::PageImage p = fitted.empty() ?
+          empdfer::create_page(inputs[i], infos[i], options(i)) :
+          std::move(fitted[i]);
+        inputs[i] = empdfer::Input();
+        return empdfer::paddlefish_page(std::move(p));
+      },
+      [&](paddlefish::PagePtr&& p) { d->push_back_page(p); });
+
+    empdfer::StageTimer timer(empdfer::STAGE_WRITE);
+    d->to_stream(out);
   }
 
+  out.flush();
+
+  if (f.is_open())
+    f.close();
+
+  empdfer::remove_temp_files();
+
+  if (!cache_dir.empty())
+    empdfer::trim_cache(cache_dir, (uintmax_t)cache_size_mb * 1024 * 1024);
+
+  write_stats();
+
   return 0;
 }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    return run(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    empdfer::remove_temp_files();
+
+    return -5;
+  }
+}
 
 // vim: ts=2:sw=2:expandtab
@@ -17,7 +17,9 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 
 #include "file_type.h"
 
@@ -43,3 +45,36 @@ empdfer::FileType empdfer::file_type(const std::string& file_path)
         return empdfer::PNG;
     else return empdfer::UNKNOWN;
 }
+
+empdfer::FileType empdfer::file_type(const unsigned char* data,
+                                     size_t size)
+{
+    static const unsigned char jpeg[] = {0xff, 0xd8, 0xff};
+    static const unsigned char png[] = {0x89, 'P', 'N', 'G', '\r', '\n',
+                                        0x1a, '\n'};
+
+    if (size >= sizeof(jpeg) && !memcmp(data, jpeg, sizeof(jpeg)))
+        return empdfer::JPEG;
+    else if (size >= sizeof(png) && !memcmp(data, png, sizeof(png)))
+        return empdfer::PNG;
+    else return empdfer::UNKNOWN;
+}
+
+empdfer::FileType empdfer::file_type(const Input& input)
+{
+    FileType type = UNKNOWN;
+    if (input.in_memory())
+        type = file_type(input.data, input.size);
+    else
+    {
+        // Files that are not mapped only need their first bytes read.
+        unsigned char signature[8];
+        std::ifstream f(input.name, std::ios_base::in|std::ios_base::binary);
+        f.read((char*)signature, sizeof(signature));
+        type = file_type(signature, f.gcount());
+    }
+
+    if (type == UNKNOWN && !input.name.empty())
+        type = file_type(input.name);
+    return type;
+}
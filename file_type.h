@@ -18,8 +18,11 @@
 #ifndef EMPDFER_FILE_TYPE_H
 #define EMPDFER_FILE_TYPE_H
 
+#include <cstddef>
 #include <string>
 
+#include "input.h"
+
 namespace empdfer {
 
 enum FileType
@@ -29,8 +32,17 @@ enum FileType
     UNKNOWN
 };
 
+// Tells the type from the extension of the file name.
 FileType file_type(const std::string&);
 
+// Tells the type from the signature at the start of the bytes.
+FileType file_type(const unsigned char* data, size_t size);
+
+// Inputs are told apart by their signature, read from the bytes in memory
+// or the mapping if there is one. Only those with an unknown signature are
+// told by their extension, so that the decoder reports what is wrong.
+FileType file_type(const Input&);
+
 } // namespace empdfer
 
 #endif // EMPDFER_FILE_TYPE_H
@@ -0,0 +1,353 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "buffer_pool.h"
+#include "ccitt.h"
+#include "image.h"
+#include "matrix.h"
+#include "sha256.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace {
+// Sets the bytes of the image to the gray samples packed at 1 bit per
+// pixel.
+void pack_image(empdfer::Image& image, const unsigned char* gray,
+                unsigned threshold)
+{
+    std::vector<unsigned char> bits = empdfer::acquire_buffer(
+        (size_t)(image.width + 7) / 8 * image.height);
+    empdfer::pack_bilevel(gray, image.width, image.height, threshold,
+                          bits.data());
+    image.data.swap(bits);
+    empdfer::release_buffer(std::move(bits));
+    image.components = 1;
+    image.bits_per_component = 1;
+    image.color_space = empdfer::DEVICE_GRAY;
+    image.filter = empdfer::FILTER_NONE;
+    image.predictor = 0;
+}
+
+// Images are compressed in chunks of this size, in parallel when there
+// are workers. The chunks do not depend on the number of workers, so
+// neither does the output. Smaller images are compressed in one go.
+const size_t deflate_chunk = 256 * 1024;
+
+// The compression level, as told by the FLEVEL bits of a zlib header.
+unsigned deflate_level_flag(int level)
+{
+    if (level == Z_DEFAULT_COMPRESSION || level == 6)
+        return 2;
+    return level < 2 ? 0 : level < 6 ? 1 : 3;
+}
+
+// Compresses length bytes at offset as part of a raw deflate stream of all
+// the data, using the 32K bytes before them as the dictionary. Unless
+// last, the output ends with a sync flush instead of the final block.
+std::vector<unsigned char> deflate_raw(const unsigned char* data,
+                                       size_t offset, size_t length,
+                                       int level, bool last)
+{
+    z_stream z;
+    z.zalloc = Z_NULL;
+    z.zfree = Z_NULL;
+    z.opaque = Z_NULL;
+    if (deflateInit2(&z, level, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("cannot compress image");
+
+    size_t window = std::min<size_t>(offset, 32 * 1024);
+    if (window > 0)
+        deflateSetDictionary(&z, data + offset - window, window);
+
+    // A sync flush adds an empty stored block of at most 5 bytes.
+    std::vector<unsigned char> out(deflateBound(&z, length) + 16);
+    z.next_in = const_cast<unsigned char*>(data + offset);
+    z.avail_in = length;
+    z.next_out = out.data();
+    z.avail_out = out.size();
+    int result = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+    out.resize(out.size() - z.avail_out);
+    deflateEnd(&z);
+
+    if (result != (last ? Z_STREAM_END : Z_OK) || z.avail_in != 0)
+        throw std::runtime_error("cannot compress image");
+    return out;
+}
+} // namespace
+
+void empdfer::layout(PageImage& p, unsigned width, unsigned height,
+                     double x_density_dpmm, double y_density_dpmm,
+                     const ImageOptions& options)
+{
+    double img_x_mm = options.img_x_mm;
+    double img_y_mm = options.img_y_mm;
+
+    // Compute the image size based on the resolution in the file.
+    if (img_x_mm == -1. && img_y_mm == -1.)
+    {
+        img_x_mm = width / x_density_dpmm;
+        img_y_mm = height / y_density_dpmm;
+    }
+    // Compute the missing dimensions to maintain aspect ratio in case one
+    // size was not specified.
+    else if (img_x_mm == -1.)
+        img_x_mm = (double)width * img_y_mm / height;
+    else
+        img_y_mm = (double)height * img_x_mm / width;
+
+    p.page_x_mm = options.page_x_mm;
+    p.page_y_mm = options.page_y_mm;
+
+    // Compute the PDF transformation matrix for the image.
+    empdfer::fill_matrix(p.matrix23, img_x_mm, img_y_mm, options.page_x_mm,
+                         options.page_y_mm, options.rotation, options.shrink);
+}
+
+int empdfer::quarter_turns(double rotation)
+{
+    double r = std::fmod(rotation, 360.);
+    if (r < 0)
+        r += 360.;
+    if (std::fmod(r, 90.) != 0.)
+        return -1;
+    return (int)(r / 90.) % 4;
+}
+
+void empdfer::layout_upright(PageImage& p, unsigned width, unsigned height,
+                             double x_density_dpmm, double y_density_dpmm,
+                             unsigned quarter_turns,
+                             const ImageOptions& options)
+{
+    ImageOptions o = options;
+    o.rotation -= 90. * quarter_turns;
+
+    if (quarter_turns % 2)
+    {
+        std::swap(width, height);
+        std::swap(x_density_dpmm, y_density_dpmm);
+        std::swap(o.img_x_mm, o.img_y_mm);
+    }
+
+    layout(p, width, height, x_density_dpmm, y_density_dpmm, o);
+}
+
+void empdfer::max_dpi_size(const PageImage& p, unsigned width,
+                           unsigned height, int max_dpi, unsigned& x,
+                           unsigned& y)
+{
+    x = width;
+    y = height;
+    if (max_dpi <= 0)
+        return;
+
+    // The placed size is the length of the matrix columns.
+    double placed_x_in = std::hypot(p.matrix23[0], p.matrix23[1]) / 72.;
+    double placed_y_in = std::hypot(p.matrix23[2], p.matrix23[3]) / 72.;
+    // Tolerate rounding errors, so that exact sizes are not rounded up.
+    x = std::min(x, (unsigned)std::ceil(placed_x_in * max_dpi - 1e-3));
+    y = std::min(y, (unsigned)std::ceil(placed_y_in * max_dpi - 1e-3));
+    x = std::max(x, 1u);
+    y = std::max(y, 1u);
+}
+
+bool empdfer::bilevel_image(Image& image, const unsigned char* gray,
+                            unsigned tolerance)
+{
+    if (!is_bilevel(gray, (size_t)image.width * image.height, tolerance))
+        return false;
+
+    pack_image(image, gray, 128);
+    return true;
+}
+
+void empdfer::threshold_image(Image& image, const Pixels& pixels,
+                              unsigned threshold)
+{
+    StageTimer timer(STAGE_TRANSFORM);
+
+    if (pixels.components == 1)
+    {
+        pack_image(image, pixels.data.data(), threshold);
+        return;
+    }
+
+    size_t n = (size_t)pixels.width * pixels.height;
+    std::vector<unsigned char> gray = acquire_buffer(n);
+    rgb_to_gray(pixels.data.data(), n, gray.data());
+    pack_image(image, gray.data(), threshold);
+    release_buffer(std::move(gray));
+}
+
+bool empdfer::reduce_colors(Image& image, unsigned tolerance)
+{
+    if (image.filter != FILTER_NONE || image.bits_per_component != 8)
+        return false;
+
+    StageTimer timer(STAGE_TRANSFORM);
+
+    bool reduced = false;
+    size_t n = (size_t)image.width * image.height;
+    if (image.components == 3 && is_gray(image.data.data(), n, tolerance))
+    {
+        reduced = true;
+        std::vector<unsigned char> gray = acquire_buffer(n);
+        rgb_to_gray(image.data.data(), n, gray.data());
+        image.data.swap(gray);
+        release_buffer(std::move(gray));
+        image.components = 1;
+        image.color_space = DEVICE_GRAY;
+    }
+
+    if (image.components == 1 && !image.mask)
+    {
+        std::vector<unsigned char> gray;
+        gray.swap(image.data);
+        if (bilevel_image(image, gray.data(), tolerance))
+            reduced = true;
+        else
+            image.data.swap(gray);
+        release_buffer(std::move(gray));
+    }
+
+    return reduced;
+}
+
+void empdfer::deflate_image(Image& image, const ImageOptions& options)
+{
+    if (image.mask)
+        deflate_image(*image.mask, options);
+
+    if (image.filter != FILTER_NONE)
+        return;
+
+    // G4 usually beats Flate on scanned text, but not on dithered or
+    // regular patterns, so both are tried. G4 takes a fraction of the time
+    // Flate does.
+    std::vector<unsigned char> g4;
+    if (image.bits_per_component == 1 && image.components == 1)
+    {
+        StageTimer timer(STAGE_ENCODE);
+        g4 = encode_g4(image.data.data(), image.width, image.height);
+    }
+
+    StageTimer timer(STAGE_DEFLATE);
+
+    int level = options.compression;
+    std::vector<unsigned char> compressed;
+
+    if (image.data.size() <= deflate_chunk)
+    {
+        uLongf size = compressBound(image.data.size());
+        compressed.resize(size);
+
+        if (compress2(compressed.data(), &size, image.data.data(),
+                      image.data.size(), level) != Z_OK)
+            throw std::runtime_error("cannot compress image");
+
+        compressed.resize(size);
+    }
+    else
+    {
+        // Like pigz: each chunk is compressed on its own, primed with the
+        // end of the previous one, and ends on a byte boundary with a sync
+        // flush, so that the chunks make a single deflate stream.
+        const unsigned char* data = image.data.data();
+        size_t size = image.data.size();
+        std::vector<std::vector<unsigned char>> chunks(
+            (size + deflate_chunk - 1) / deflate_chunk);
+        std::vector<uLong> checksums(chunks.size());
+
+        empdfer::parallel_for(options.pool, chunks.size(), [&](size_t i)
+        {
+            size_t offset = i * deflate_chunk;
+            size_t length = std::min(deflate_chunk, size - offset);
+            bool last = i + 1 == chunks.size();
+
+            checksums[i] = adler32(adler32(0L, Z_NULL, 0), data + offset,
+                                   length);
+            chunks[i] = deflate_raw(data, offset, length, level, last);
+        });
+
+        // A zlib header and, at the end, the checksum of all the data.
+        unsigned header = 0x7800 | deflate_level_flag(level) << 6;
+        header += (31 - header % 31) % 31;
+        uLong checksum = checksums[0];
+        size_t total = 6;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            if (i > 0)
+                checksum = adler32_combine(checksum, checksums[i],
+                                           std::min(deflate_chunk,
+                                                    size - i * deflate_chunk));
+            total += chunks[i].size();
+        }
+
+        compressed.reserve(total);
+        compressed.push_back(header >> 8);
+        compressed.push_back(header & 0xff);
+        for (std::vector<unsigned char>& chunk : chunks)
+        {
+            compressed.insert(compressed.end(), chunk.begin(), chunk.end());
+            std::vector<unsigned char>().swap(chunk);
+        }
+        for (int shift = 24; shift >= 0; shift -= 8)
+            compressed.push_back((checksum >> shift) & 0xff);
+    }
+
+    timer.stop();
+
+    if (!g4.empty() && g4.size() < compressed.size())
+    {
+        compressed.swap(g4);
+        image.filter = FILTER_CCITT;
+    }
+    else
+        image.filter = FILTER_FLATE;
+    image.data.swap(compressed);
+
+    empdfer::release_buffer(std::move(compressed));
+}
+
+void empdfer::digest_image(Image& image)
+{
+    if (image.mask)
+        digest_image(*image.mask);
+
+    StageTimer timer(STAGE_HASH);
+
+    Sha256 sha;
+    sha.update(std::to_string(image.width) + " " +
+               std::to_string(image.height) + " " +
+               std::to_string(image.components) + " " +
+               std::to_string(image.bits_per_component) + " " +
+               std::to_string(image.color_space) + " " +
+               std::to_string(image.filter) + " " +
+               std::to_string(image.predictor) + " " +
+               (image.mask ? image.mask->digest : "-") + "\n");
+    if (image.source.empty())
+        sha.update(image.data.data(), image.data.size());
+    else
+        sha.update(empdfer::sha256_input(image.source));
+    image.digest = sha.hex_digest();
+}
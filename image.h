@@ -0,0 +1,201 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_IMAGE_H
+#define EMPDFER_IMAGE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_type.h"
+#include "input.h"
+#include "pixels.h"
+
+namespace empdfer {
+
+class ThreadPool;
+
+enum ColorSpace
+{
+    DEVICE_GRAY,
+    DEVICE_RGB
+};
+
+// How the bytes of an image are encoded.
+enum ImageFilter
+{
+    FILTER_NONE,
+    FILTER_FLATE,
+    FILTER_DCT,
+    // CCITT Group 4, for 1-bit gray images.
+    FILTER_CCITT
+};
+
+// An image, ready to be embedded in a page.
+struct Image
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned components = 0;
+    unsigned bits_per_component = 8;
+    ColorSpace color_space = DEVICE_RGB;
+
+    ImageFilter filter = FILTER_NONE;
+    // PNG predictor the Flate data was filtered with, 0 if none.
+    unsigned predictor = 0;
+    std::vector<unsigned char> data;
+    // If not empty, the encoded bytes are those of this input and data is
+    // empty.
+    Input source;
+
+    // For JPEG images whose quality is yet to be chosen, the pixels to
+    // encode, see ImageOptions::defer_jpeg. Data is empty meanwhile.
+    std::shared_ptr<Pixels> pixels;
+
+    // Soft mask (alpha channel) of the image, if any.
+    std::shared_ptr<Image> mask;
+
+    // Identifies the image once encoded, so that outputs can embed
+    // identical images only once. Empty if not computed.
+    std::string digest;
+};
+
+// What the header of an input file tells about its image, gathered before
+// decoding anything.
+struct ImageInfo
+{
+    FileType type = UNKNOWN;
+    unsigned width = 0;
+    unsigned height = 0;
+    // Color channels, without alpha, once palettes are expanded.
+    unsigned components = 0;
+    unsigned bits_per_component = 8;
+    ColorSpace color_space = DEVICE_RGB;
+    bool alpha = false;
+    bool indexed = false;
+    bool interlaced = false;
+    double x_density_dpmm = 0.;
+    double y_density_dpmm = 0.;
+    // Quality the image was saved with, -1 if unknown.
+    int quality = -1;
+    uintmax_t file_size = 0;
+};
+
+// The options given for one input image.
+struct ImageOptions
+{
+    double page_x_mm = 210.;
+    double page_y_mm = 297.;
+    double img_x_mm = -1.;
+    double img_y_mm = -1.;
+    int quality = -1;
+    double rotation = 0.;
+    bool shrink = true;
+    // Maximum resolution of the placed image, in dots per inch. Images
+    // with more pixels than needed are scaled down (-1 means no limit).
+    int max_dpi = -1;
+    // Whether the output can take Flate data as it is stored in PNG files.
+    bool embed_flate = false;
+    // Directory where recompressed images are cached, empty for none.
+    std::string cache_dir;
+    // Whether rotations by multiples of 90 degrees are applied to the
+    // image itself, when it can be done without loss, instead of being
+    // left to the viewer.
+    bool upright = false;
+    // Whether images to be encoded as JPEG keep their pixels instead, so
+    // that they can be encoded later with several qualities. JPEG images
+    // are never embedded as they are then. The quality must not be -1, so
+    // that PNG images are decoded for JPEG too.
+    bool defer_jpeg = false;
+    // zlib compression level of the images compressed by empdfer itself,
+    // -1 for zlib's default.
+    int compression = -1;
+    // Workers that can help encoding a single large image, if any.
+    ThreadPool* pool = NULL;
+    // Color images whose channels differ by at most this much are
+    // embedded as gray, and gray images within this much of black or
+    // white as 1 bit per pixel (-1 means color images stay as they are).
+    int gray_tolerance = -1;
+    // Images are made black and white, with the samples darker than this
+    // level black (-1 means they keep their colors).
+    int threshold = -1;
+};
+
+// A page holding a single image.
+struct PageImage
+{
+    double page_x_mm = 0.;
+    double page_y_mm = 0.;
+    double matrix23[6] = {0., 0., 0., 0., 0., 0.};
+    Image image;
+};
+
+// Sets the page size of p and computes the matrix placing an image of
+// width x height pixels on it, given its density in dots per millimeter.
+void layout(PageImage& p, unsigned width, unsigned height,
+            double x_density_dpmm, double y_density_dpmm,
+            const ImageOptions&);
+
+// Number of counter-clockwise quarter turns the rotation makes, or -1 if it
+// is not a multiple of 90 degrees.
+int quarter_turns(double rotation);
+
+// Lays out an image that was already rotated by the given quarter turns,
+// so that it is placed as the original image rotated by options.rotation
+// would be. width, height and the densities are those of the original.
+void layout_upright(PageImage& p, unsigned width, unsigned height,
+                    double x_density_dpmm, double y_density_dpmm,
+                    unsigned quarter_turns, const ImageOptions&);
+
+// Computes the size in pixels an image of width x height needs, laid out
+// as in p, to be shown at no more than max_dpi dots per inch. The size is
+// never larger than the original one.
+void max_dpi_size(const PageImage& p, unsigned width, unsigned height,
+                  int max_dpi, unsigned& x, unsigned& y);
+
+// Sets the bytes of the image to the gray samples packed at 1 bit per
+// pixel, if they are all within tolerance of black or white, and returns
+// whether they were. The size of the image must be set.
+bool bilevel_image(Image&, const unsigned char* gray, unsigned tolerance);
+
+// Sets the bytes of the image to the pixels, gray or RGB, made black and
+// white with the threshold (see ImageOptions::threshold) and packed at 1
+// bit per pixel. The size of the image must be set.
+void threshold_image(Image&, const Pixels&, unsigned threshold);
+
+// Turns a FILTER_NONE image with 8 bits per component into gray, or into 1
+// bit per pixel, when its samples allow it within tolerance. Images with a
+// mask keep 8 bits, since the image and its mask share the bit depth.
+// Returns whether the image changed.
+bool reduce_colors(Image&, unsigned tolerance);
+
+// Compresses the bytes of a FILTER_NONE image (and its mask) with Flate,
+// with the compression level of the options. Large images are compressed
+// in chunks, shared with the workers of the pool of the options, if any.
+// 1-bit gray images are encoded with CCITT G4 instead, unless Flate makes
+// them smaller.
+void deflate_image(Image&, const ImageOptions& = ImageOptions());
+
+// Fills in the digest of the image and of its mask, hashing the encoded
+// bytes and everything else that ends up in the image dictionary.
+void digest_image(Image&);
+
+} // namespace empdfer
+
+#endif // EMPDFER_IMAGE_H
@@ -0,0 +1,163 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_cache.h"
+#include "sha256.h"
+#include "stats.h"
+#include "temp_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+namespace {
+// Changing the format of the entries, or the way images are encoded,
+// must change this so that old entries are not used.
+const char* const format = "empdfer-cache-3";
+
+std::filesystem::path entry_path(const std::string& dir,
+                                 const std::string& key)
+{
+    return std::filesystem::path(dir) / (key + ".img");
+}
+} // namespace
+
+std::string empdfer::cache_key(const Input& input,
+                               const std::string& params)
+{
+    Sha256 sha;
+    sha.update(std::string(format) + "\n" + params + "\n" +
+               empdfer::sha256_input(input));
+    return sha.hex_digest();
+}
+
+bool empdfer::load_cached_image(const std::string& dir,
+                                const std::string& key, Image& image)
+{
+    std::filesystem::path path = entry_path(dir, key);
+    std::ifstream f(path, std::ios_base::in|std::ios_base::binary);
+    if (!f)
+        return false;
+
+    // The entry is a line describing the image, followed by its bytes.
+    std::string header;
+    std::getline(f, header);
+
+    std::istringstream h(header);
+    std::string tag;
+    unsigned width, height, components, bits, color_space, filter;
+    size_t size;
+    if (!(h >> tag >> width >> height >> components >> bits >>
+          color_space >> filter >> size) || tag != format)
+        return false;
+
+    std::vector<unsigned char> data(size);
+    if (!f.read((char*)data.data(), size))
+        return false;
+    count(COUNTER_BYTES_READ, size);
+
+    image.width = width;
+    image.height = height;
+    image.components = components;
+    image.bits_per_component = bits;
+    image.color_space = (ColorSpace)color_space;
+    image.filter = (ImageFilter)filter;
+    image.source = Input();
+    image.data.swap(data);
+
+    // The modification time tells which entries were used last.
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now(), ec);
+
+    return true;
+}
+
+void empdfer::store_cached_image(const std::string& dir,
+                                 const std::string& key, const Image& image)
+{
+    static std::atomic<unsigned long> counter(0);
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // Write under a name private to this process and call, and rename, so
+    // that other processes never see a partial entry.
+    std::filesystem::path path = entry_path(dir, key);
+    std::filesystem::path temp = path;
+    temp += "." + empdfer::process_tag() + "." + std::to_string(counter++) +
+            ".tmp";
+
+    {
+        std::ofstream f(temp, std::ios_base::out|std::ios_base::binary);
+        f << format << " " << image.width << " " << image.height << " " <<
+             image.components << " " << image.bits_per_component << " " <<
+             (unsigned)image.color_space << " " << (unsigned)image.filter <<
+             " " << image.data.size() << "\n";
+        f.write((const char*)image.data.data(), image.data.size());
+        if (!f)
+        {
+            // A cache that cannot be written is not an error.
+            f.close();
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+
+    count(COUNTER_BYTES_WRITTEN, image.data.size());
+
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+        std::filesystem::remove(temp, ec);
+}
+
+void empdfer::trim_cache(const std::string& dir, uintmax_t max_bytes)
+{
+    typedef std::tuple<std::filesystem::file_time_type, uintmax_t,
+                       std::filesystem::path> Entry;
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(dir, ec))
+    {
+        if (e.path().extension() != ".img")
+            continue;
+
+        uintmax_t size = e.file_size(ec);
+        if (ec)
+            continue;
+
+        entries.emplace_back(e.last_write_time(ec), size, e.path());
+        total += size;
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& e : entries)
+    {
+        if (total <= max_bytes)
+            break;
+
+        if (std::filesystem::remove(std::get<2>(e), ec))
+            total -= std::get<1>(e);
+    }
+}
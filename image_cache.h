@@ -0,0 +1,50 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_IMAGE_CACHE_H
+#define EMPDFER_IMAGE_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "image.h"
+
+namespace empdfer {
+
+// A directory holding recompressed images, so that rebuilding a document
+// from the same inputs does not need to encode them again. Entries are
+// named after a hash of the input file contents and of the parameters
+// that affect the result. Several processes can share the directory.
+
+// Key of the result of processing the input with the given parameters.
+std::string cache_key(const Input&, const std::string& params);
+
+// If the cache has an entry for the key, fills in the encoded bytes and
+// size of the image and returns true.
+bool load_cached_image(const std::string& dir, const std::string& key,
+                       Image&);
+
+void store_cached_image(const std::string& dir, const std::string& key,
+                        const Image&);
+
+// Removes the least recently used entries until the cache takes at most
+// the given number of bytes.
+void trim_cache(const std::string& dir, uintmax_t max_bytes);
+
+} // namespace empdfer
+
+#endif // EMPDFER_IMAGE_CACHE_H
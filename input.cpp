@@ -0,0 +1,128 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "input.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#ifndef EMPDFER_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+empdfer::MappedFile::MappedFile(const std::string& file) :
+    data_(NULL), size_(0)
+{
+#ifdef EMPDFER_WINDOWS
+    throw std::runtime_error(file + ": can't map input file");
+#else
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(file + ": can't open input file");
+
+    // The mapping stays valid once the descriptor is closed.
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw std::runtime_error(file + ": can't map input file");
+
+    data_ = (const unsigned char*)p;
+    size_ = st.st_size;
+#endif // EMPDFER_WINDOWS
+}
+
+empdfer::MappedFile::~MappedFile()
+{
+#ifndef EMPDFER_WINDOWS
+    munmap((void*)data_, size_);
+#endif
+}
+
+uintmax_t empdfer::input_size(const Input& input)
+{
+    return input.in_memory() ? input.size :
+                               std::filesystem::file_size(input.name);
+}
+
+empdfer::Input empdfer::map_input(const Input& input)
+{
+    if (input.in_memory() || input.empty())
+        return input;
+
+    Input mapped(input.name);
+    try
+    {
+        mapped.mapping = std::make_shared<MappedFile>(input.name);
+    }
+    catch (const std::runtime_error&)
+    {
+        // Too many mappings, or something that is not a regular file.
+        return input;
+    }
+    mapped.data = mapped.mapping->data();
+    mapped.size = mapped.mapping->size();
+    return mapped;
+}
+
+empdfer::MemoryStreamBuf::MemoryStreamBuf(const unsigned char* data,
+                                          size_t size)
+{
+    // The buffer is only read, the get area just needs non-const pointers.
+    char* begin = (char*)data;
+    setg(begin, begin, begin + size);
+}
+
+empdfer::MemoryStreamBuf::pos_type
+empdfer::MemoryStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                  std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::in))
+        return pos_type(off_type(-1));
+
+    off_type base = dir == std::ios_base::beg ? 0 :
+                    dir == std::ios_base::cur ? gptr() - eback() :
+                                                egptr() - eback();
+    off_type pos = base + off;
+    if (pos < 0 || pos > egptr() - eback())
+        return pos_type(off_type(-1));
+
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+}
+
+empdfer::MemoryStreamBuf::pos_type
+empdfer::MemoryStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+empdfer::InputStream::InputStream(const Input& input) :
+    std::istream(NULL), memory_(input.data, input.in_memory() ? input.size : 0)
+{
+    if (input.in_memory())
+        rdbuf(&memory_);
+    else if (file_.open(input.name, std::ios_base::in|std::ios_base::binary))
+        rdbuf(&file_);
+    else
+        setstate(std::ios_base::failbit);
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_INPUT_H
+#define EMPDFER_INPUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace empdfer {
+
+// A file mapped read-only into memory, for as long as the object lives.
+class MappedFile
+{
+public:
+    // Throws std::runtime_error if the file cannot be mapped.
+    explicit MappedFile(const std::string& file);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+};
+
+// The encoded bytes of an image, either in a file or in memory owned by
+// the caller, who must keep them until the pages showing the image are
+// written. For bytes in memory, the name is only used in messages.
+struct Input
+{
+    std::string name;
+    const unsigned char* data = NULL;
+    size_t size = 0;
+    // For files mapped into memory, the mapping the data points to. It is
+    // kept by every copy of the input, such as the source of an image.
+    std::shared_ptr<const MappedFile> mapping;
+
+    Input() {}
+    Input(const std::string& file) : name(file) {}
+    Input(const char* file) : name(file) {}
+    Input(const std::string& name, const unsigned char* data, size_t size) :
+        name(name), data(data), size(size) {}
+
+    bool in_memory() const { return data != NULL; }
+    bool mapped() const { return mapping != NULL; }
+    bool empty() const { return name.empty() && data == NULL; }
+};
+
+// Size of the encoded bytes.
+uintmax_t input_size(const Input&);
+
+// Maps the file of the input into memory, so that decoders, hashes and the
+// writer all read the same pages instead of opening the file each. Returns
+// the input as it is if it is in memory already or if the file cannot be
+// mapped, leaving any error to whoever reads it.
+Input map_input(const Input&);
+
+// Reads bytes in memory through a stream, without copying them.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const unsigned char* data, size_t size);
+
+protected:
+    pos_type seekoff(off_type, std::ios_base::seekdir,
+                     std::ios_base::openmode) override;
+    pos_type seekpos(pos_type, std::ios_base::openmode) override;
+};
+
+// Stream over the bytes of an input. Like std::ifstream, it is in a failed
+// state if the file cannot be opened.
+class InputStream : public std::istream
+{
+public:
+    explicit InputStream(const Input&);
+
+private:
+    std::filebuf file_;
+    MemoryStreamBuf memory_;
+};
+
+} // namespace empdfer
+
+#endif // EMPDFER_INPUT_H
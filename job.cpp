@@ -0,0 +1,136 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "job.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+const empdfer::JsonValue* member(const empdfer::JsonValue& object,
+                                 const std::string& name,
+                                 empdfer::JsonValue::Type type)
+{
+    const empdfer::JsonValue* v = object.find(name);
+    if (v && v->type != type)
+        throw std::runtime_error("job: wrong type for \"" + name + "\"");
+    return v;
+}
+
+// The value of an integer member. It is checked against the range before
+// the conversion, which is undefined for numbers that do not fit.
+int integer(const empdfer::JsonValue& v, const std::string& name, int min,
+            int max)
+{
+    if (!(v.number >= min && v.number <= max))
+        throw std::runtime_error("job: \"" + name + "\" must be from " +
+                                 std::to_string(min) + " to " +
+                                 std::to_string(max));
+    return (int)v.number;
+}
+
+// Sets the options present in the object, leaving the others as they are.
+void read_options(const empdfer::JsonValue& object,
+                  empdfer::ImageOptions& o)
+{
+    const empdfer::JsonValue::Type number = empdfer::JsonValue::JSON_NUMBER;
+    const empdfer::JsonValue::Type boolean = empdfer::JsonValue::JSON_BOOLEAN;
+    const empdfer::JsonValue* v;
+
+    if ((v = member(object, "page_x", number)))
+        o.page_x_mm = v->number;
+    if ((v = member(object, "page_y", number)))
+        o.page_y_mm = v->number;
+    if ((v = member(object, "size_x", number)))
+        o.img_x_mm = v->number;
+    if ((v = member(object, "size_y", number)))
+        o.img_y_mm = v->number;
+    if ((v = member(object, "quality", number)))
+        o.quality = integer(*v, "quality", -1, 100);
+    if ((v = member(object, "compression", number)))
+        o.compression = integer(*v, "compression", 0, 9);
+    // -1 turns it off for jobs served with -g.
+    if ((v = member(object, "gray", number)))
+        o.gray_tolerance = integer(*v, "gray", -1, 255);
+    if ((v = member(object, "rotation", number)))
+        o.rotation = v->number;
+    if ((v = member(object, "threshold", number)))
+        o.threshold = integer(*v, "threshold", -1, 255);
+    // Any value below 1 means no limit.
+    if ((v = member(object, "max_dpi", number)))
+        o.max_dpi = integer(*v, "max_dpi", -1, 1000000);
+    if ((v = member(object, "shrink", boolean)))
+        o.shrink = v->boolean;
+    if ((v = member(object, "upright", boolean)))
+        o.upright = v->boolean;
+}
+} // namespace
+
+empdfer::Job empdfer::parse_job(const JsonValue& object,
+                                const ImageOptions& defaults)
+{
+    if (object.type != JsonValue::JSON_OBJECT)
+        throw std::runtime_error("job: not a JSON object");
+
+    Job job;
+    const JsonValue* v;
+
+    if ((v = object.find("id")))
+        job.id = *v;
+    if ((v = member(object, "output", JsonValue::JSON_STRING)))
+        job.output = v->string;
+
+    ImageOptions options = defaults;
+    read_options(object, options);
+
+    const JsonValue* pages = member(object, "pages", JsonValue::JSON_ARRAY);
+    if (!pages || pages->array.empty())
+        throw std::runtime_error("job: no pages");
+
+    for (const JsonValue& page : pages->array)
+    {
+        if (page.type != JsonValue::JSON_OBJECT)
+            throw std::runtime_error("job: a page is not a JSON object");
+
+        JobPage p;
+        p.options = options;
+        read_options(page, p.options);
+
+        if ((v = member(page, "file", JsonValue::JSON_STRING)))
+            p.input = Input(v->string);
+        else if ((v = member(page, "data", JsonValue::JSON_STRING)))
+            p.data = empdfer::base64_decode(v->string);
+        else
+            throw std::runtime_error("job: a page has no \"file\" or "
+                                     "\"data\"");
+
+        job.pages.push_back(std::move(p));
+    }
+
+    return job;
+}
+
+void empdfer::add_pages(Job& job, Document& d)
+{
+    for (JobPage& p : job.pages)
+    {
+        if (p.input.empty())
+            d.add_page(std::move(p.data), p.options);
+        else
+            d.add_page(p.input, p.options);
+    }
+}
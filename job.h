@@ -0,0 +1,68 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_JOB_H
+#define EMPDFER_JOB_H
+
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "input.h"
+#include "json.h"
+#include "libempdfer.h"
+
+namespace empdfer {
+
+// A document to build, described by a JSON object like
+//
+//     {"id": 1, "output": "out.pdf", "page_x": 210, "page_y": 297,
+//      "quality": 80, "compression": 9, "gray": 8, "max_dpi": 150,
+//      "upright": true, "shrink": true,
+//      "pages": [{"file": "a.jpg", "rotation": 90},
+//                {"file": "scan.png", "threshold": 128},
+//                {"data": "<base64 bytes>", "quality": 60}]}
+//
+// Only "pages" is required. The options of a page default to those of
+// the document, and these to the ones given in the command line. Sizes
+// are in millimeters, as in the command line.
+struct JobPage
+{
+    Input input;
+    // Bytes of the image, for pages given as "data".
+    std::vector<unsigned char> data;
+    ImageOptions options;
+};
+
+struct Job
+{
+    // Echoed in the answer, so that clients can match them.
+    JsonValue id;
+    // Where to write the document. If empty, it goes back in the answer.
+    std::string output;
+    std::vector<JobPage> pages;
+};
+
+// Throws std::runtime_error if the object does not describe a job.
+Job parse_job(const JsonValue&, const ImageOptions& defaults);
+
+// Adds the pages of the job to the document, handing their data over.
+void add_pages(Job&, Document&);
+
+} // namespace empdfer
+
+#endif // EMPDFER_JOB_H
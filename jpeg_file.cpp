@@ -15,33 +15,290 @@
 // You should have received a copy of the GNU General Public License
 // along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "buffer_pool.h"
+#include "image_cache.h"
 #include "jpeg_file.h"
-#include "matrix.h"
+#include "stats.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
-#include <filesystem>
-#include <fstream>
-#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <jerror.h>
 
-void empdfer::create_jpeg(const std::string& compressed_file,
-                          unsigned char* data, long width, long height,
-                          unsigned components, J_COLOR_SPACE color_space,
-                          int quality)
+namespace {
+// The luminance quantization table from the JPEG standard, which libjpeg
+// scales according to the quality.
+const unsigned std_luminance_quant_tbl[DCTSIZE2] = {
+  16,  11,  10,  16,  24,  40,  51,  61,
+  12,  12,  14,  19,  26,  58,  60,  55,
+  14,  13,  16,  24,  40,  57,  69,  56,
+  14,  17,  22,  29,  51,  87,  80,  62,
+  18,  22,  37,  56,  68, 109, 103,  77,
+  24,  35,  55,  64,  81, 104, 113,  92,
+  49,  64,  78,  87, 103, 121, 120, 101,
+  72,  92,  95,  98, 112, 100, 103,  99
+};
+
+// Guesses the quality setting the image was saved with, by comparing its
+// first quantization table with the standard one. The inverse of
+// jpeg_quality_scaling().
+int estimate_quality(const jpeg_decompress_struct& cinfo)
+{
+  const JQUANT_TBL* table = cinfo.quant_tbl_ptrs[0];
+  if (table == NULL)
+    return 75;
+
+  double sum = 0.;
+  for (unsigned i = 0; i < DCTSIZE2; ++i)
+    sum += 100. * table->quantval[i] / std_luminance_quant_tbl[i];
+  double scale = sum / DCTSIZE2;
+
+  int quality = scale <= 100. ? (int)std::lround((200. - scale) / 2.) :
+                                (int)std::lround(5000. / scale);
+  return std::clamp(quality, 1, 100);
+}
+
+// Rotates one block of DCT coefficients counter-clockwise. In the frequency
+// domain, transposing the block transposes the coefficients, and mirroring
+// it negates the odd frequencies along the mirrored axis.
+void rotate_block(const JCOEF* in, JCOEF* out, unsigned quarter_turns)
+{
+  for (unsigned i = 0; i < DCTSIZE; ++i)
+    for (unsigned j = 0; j < DCTSIZE; ++j)
+    {
+      switch (quarter_turns)
+      {
+        case 1:
+          out[i * DCTSIZE + j] = i & 1 ? -in[j * DCTSIZE + i] :
+                                         in[j * DCTSIZE + i];
+          break;
+        case 2:
+          out[i * DCTSIZE + j] = (i + j) & 1 ? -in[i * DCTSIZE + j] :
+                                               in[i * DCTSIZE + j];
+          break;
+        default:
+          out[i * DCTSIZE + j] = j & 1 ? -in[j * DCTSIZE + i] :
+                                         in[j * DCTSIZE + i];
+          break;
+      }
+    }
+}
+
+// Quantizes the coefficients of a block again. scales holds the ratio of
+// the old steps to the new ones, in 16.16 fixed point. The loop has no
+// branches, so that compilers can vectorize it.
+void requantize_block(JCOEF* block, const int32_t* scales)
+{
+  for (unsigned k = 0; k < DCTSIZE2; ++k)
+  {
+    int32_t value = block[k];
+    int32_t magnitude = value < 0 ? -value : value;
+    int32_t scaled = (magnitude * scales[k] + 32768) >> 16;
+    block[k] = (JCOEF)(value < 0 ? -scaled : scaled);
+  }
+}
+
+// Makes libjpeg throw on errors instead of exiting, so that a bad image
+// does not end a long-running process.
+struct error_mgr
+{
+  jpeg_error_mgr pub;
+  // What is being read or written, for messages.
+  std::string name;
+};
+
+void throw_error(j_common_ptr cinfo)
+{
+  char message[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, message);
+  throw std::runtime_error(((error_mgr*)cinfo->err)->name + ": " + message);
+}
+
+// The libjpeg objects are set up once per thread and reused for every
+// image, which matters to processes converting many small images. Each use
+// starts with jpeg_abort_*(), which also cleans up after errors.
+
+// libjpeg-turbo installs the standard Huffman tables only where there are
+// none, so an object would keep the optimized tables of the last image it
+// encoded, or the tables of the last one it decoded. Each use starts over
+// from these instead.
+struct standard_huff_tables_t
+{
+  JHUFF_TBL dc[2];
+  JHUFF_TBL ac[2];
+
+  standard_huff_tables_t()
+  {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr err;
+    cinfo.err = jpeg_std_error(&err);
+    jpeg_create_compress(&cinfo);
+    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    jpeg_set_defaults(&cinfo);
+    for (unsigned i = 0; i < 2; ++i)
+    {
+      dc[i] = *cinfo.dc_huff_tbl_ptrs[i];
+      ac[i] = *cinfo.ac_huff_tbl_ptrs[i];
+    }
+    jpeg_destroy_compress(&cinfo);
+  }
+};
+
+void reset_huff_tables(JHUFF_TBL** dc, JHUFF_TBL** ac)
+{
+  static const standard_huff_tables_t standard;
+  for (unsigned i = 0; i < 2; ++i)
+  {
+    if (dc[i] != NULL)
+      *dc[i] = standard.dc[i];
+    if (ac[i] != NULL)
+      *ac[i] = standard.ac[i];
+  }
+}
+
+struct decompressor_t
+{
+  jpeg_decompress_struct cinfo;
+  error_mgr err;
+  // libjpeg-turbo refuses to turn a source manager into one of another
+  // kind, so one of each is kept.
+  jpeg_source_mgr* file_src = NULL;
+  jpeg_source_mgr* memory_src = NULL;
+
+  decompressor_t()
+  {
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = throw_error;
+    jpeg_create_decompress(&cinfo);
+  }
+
+  ~decompressor_t() { jpeg_destroy_decompress(&cinfo); }
+};
+
+struct compressor_t
 {
   jpeg_compress_struct cinfo;
-  struct jpeg_error_mgr err;
+  error_mgr err;
+
+  compressor_t()
+  {
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = throw_error;
+    jpeg_create_compress(&cinfo);
+  }
+
+  ~compressor_t() { jpeg_destroy_compress(&cinfo); }
+};
+
+typedef std::unique_ptr<FILE, int (*)(FILE*)> file_ptr;
 
-  FILE* outfile;
-  if ((outfile = fopen(compressed_file.c_str(), "wb")) == NULL)
+// Returns the decompressor of the calling thread, reading the bytes of the
+// input. If they are in a file, infile keeps it open.
+jpeg_decompress_struct& decompressor(const empdfer::Input& input,
+                                     file_ptr& infile)
+{
+  thread_local decompressor_t d;
+  jpeg_abort_decompress(&d.cinfo);
+  reset_huff_tables(d.cinfo.dc_huff_tbl_ptrs, d.cinfo.ac_huff_tbl_ptrs);
+  d.err.name = input.name;
+
+  if (input.in_memory())
+  {
+    d.cinfo.src = d.memory_src;
+    jpeg_mem_src(&d.cinfo, input.data, input.size);
+    d.memory_src = d.cinfo.src;
+  }
+  else
   {
-    std::cerr << "can't open output file \"" << compressed_file << "\"" << std::endl;
-    exit(-1);
+    infile.reset(fopen(input.name.c_str(), "rb"));
+    if (!infile)
+      throw std::runtime_error(input.name + ": can't open input file");
+
+    d.cinfo.src = d.file_src;
+    jpeg_stdio_src(&d.cinfo, infile.get());
+    d.file_src = d.cinfo.src;
   }
 
-  cinfo.err = jpeg_std_error(&err);
-  jpeg_create_compress(&cinfo);
-  jpeg_stdio_dest(&cinfo, outfile);
+  return d.cinfo;
+}
+
+jpeg_compress_struct& compressor(const std::string& name)
+{
+  thread_local compressor_t c;
+  jpeg_abort_compress(&c.cinfo);
+  reset_huff_tables(c.cinfo.dc_huff_tbl_ptrs, c.cinfo.ac_huff_tbl_ptrs);
+  c.err.name = name;
+  return c.cinfo;
+}
+
+void count_bytes_read(const file_ptr& infile, const empdfer::Input& input)
+{
+  empdfer::count(empdfer::COUNTER_BYTES_READ,
+                 infile ? ftell(infile.get()) : input.size);
+}
+
+// A libjpeg destination manager that appends the compressed bytes to a
+// vector, so that the encoded image never needs to go through a file.
+struct vector_destination_mgr
+{
+  jpeg_destination_mgr pub;
+  std::vector<unsigned char>* out;
+};
+
+const size_t output_chunk = 64 * 1024;
+
+void init_vector_destination(j_compress_ptr cinfo)
+{
+  vector_destination_mgr* dest = (vector_destination_mgr*)cinfo->dest;
+  dest->out->resize(output_chunk);
+  dest->pub.next_output_byte = dest->out->data();
+  dest->pub.free_in_buffer = dest->out->size();
+}
+
+boolean empty_vector_output_buffer(j_compress_ptr cinfo)
+{
+  // libjpeg calls this only when the whole buffer is full.
+  vector_destination_mgr* dest = (vector_destination_mgr*)cinfo->dest;
+  size_t used = dest->out->size();
+  dest->out->resize(2 * used);
+  dest->pub.next_output_byte = dest->out->data() + used;
+  dest->pub.free_in_buffer = dest->out->size() - used;
+  return TRUE;
+}
+
+void term_vector_destination(j_compress_ptr cinfo)
+{
+  vector_destination_mgr* dest = (vector_destination_mgr*)cinfo->dest;
+  dest->out->resize(dest->out->size() - dest->pub.free_in_buffer);
+}
+
+void vector_dest(j_compress_ptr cinfo, vector_destination_mgr* dest,
+                 std::vector<unsigned char>* out)
+{
+  dest->pub.init_destination = init_vector_destination;
+  dest->pub.empty_output_buffer = empty_vector_output_buffer;
+  dest->pub.term_destination = term_vector_destination;
+  dest->out = out;
+  cinfo->dest = &dest->pub;
+}
+
+std::vector<unsigned char> encode(const unsigned char* data, long width,
+                                  long height, unsigned components,
+                                  J_COLOR_SPACE color_space, int quality)
+{
+  empdfer::StageTimer timer(empdfer::STAGE_ENCODE);
+
+  jpeg_compress_struct& cinfo = compressor("JPEG encoder");
+  vector_destination_mgr dest;
+  std::vector<unsigned char> compressed;
+
+  vector_dest(&cinfo, &dest, &compressed);
 
   cinfo.image_width = width;
   cinfo.image_height = height;
@@ -53,138 +310,636 @@ void empdfer::create_jpeg(const std::string& compressed_file,
 
   jpeg_start_compress(&cinfo, TRUE);
 
-  int row_stride = width * components;
+  size_t row_stride = width * components;
   JSAMPROW row_pointer[1];
 
   while (cinfo.next_scanline < cinfo.image_height)
   {
-    row_pointer[0] = &data[cinfo.next_scanline * row_stride];
+    row_pointer[0] = const_cast<unsigned char*>(data) +
+                     cinfo.next_scanline * row_stride;
     jpeg_write_scanlines(&cinfo, row_pointer, 1);
   }
 
   jpeg_finish_compress(&cinfo);
-  fclose(outfile);
-  jpeg_destroy_compress(&cinfo);
+
+  return compressed;
 }
 
-void empdfer::recompress_jpeg(const std::string& input_file,
-                              const std::string& compressed_file, int quality)
+// Tall images are encoded in bands of this many MCU rows, on as many
+// threads as there are, and the bands are joined with restart markers
+// between them. The bands do not depend on the number of threads, so
+// neither does the output.
+const long band_mcu_rows = 16;
+
+// The markers needed to join the bands, which libjpeg does not export.
+enum
+{
+  MARKER_SOF0 = 0xc0,
+  MARKER_SOF2 = 0xc2,
+  MARKER_RST0 = 0xd0,
+  MARKER_EOI = 0xd9,
+  MARKER_SOS = 0xda,
+  MARKER_DRI = 0xdd
+};
+
+// Returns where the entropy-coded data of a JPEG image written by libjpeg
+// starts, past the scan header, and sets sof to where the frame header is.
+size_t scan_data(const std::vector<unsigned char>& jpeg, size_t& sof)
 {
-  jpeg_decompress_struct dinfo;
-  struct jpeg_error_mgr err;
+  // After SOI, every marker up to SOS starts a segment with its length.
+  size_t i = 2;
+  while (i + 4 <= jpeg.size() && jpeg[i] == 0xff)
+  {
+    unsigned char marker = jpeg[i + 1];
+    size_t length = (jpeg[i + 2] << 8) | jpeg[i + 3];
+    if (marker >= MARKER_SOF0 && marker <= MARKER_SOF2)
+      sof = i;
+    i += 2 + length;
+    if (marker == MARKER_SOS)
+      return i;
+  }
+  throw std::runtime_error("JPEG encoder: no scan in a band");
+}
 
-  jpeg_create_decompress(&dinfo);
-  dinfo.err = jpeg_std_error(&err);
+// Joins images of consecutive bands of the same width, all encoded with
+// the same settings, into an image of the given height. All the bands but
+// the last must have restart_interval MCUs.
+std::vector<unsigned char> join_bands(
+  const std::vector<std::vector<unsigned char>>& bands, long height,
+  unsigned restart_interval)
+{
+  size_t size = 0;
+  for (const std::vector<unsigned char>& band : bands)
+    size += band.size() + 2;
+
+  // The headers of the first band, with the height of the whole image and
+  // the restart interval, which goes right before the scan header.
+  const std::vector<unsigned char>& first = bands[0];
+  size_t sof = 0;
+  size_t start = scan_data(first, sof);
+  size_t sos = sof;
+  while (first[sos + 1] != MARKER_SOS)
+    sos += 2 + ((first[sos + 2] << 8) | first[sos + 3]);
+
+  std::vector<unsigned char> joined;
+  joined.reserve(size + 6);
+  joined.insert(joined.end(), first.begin(), first.begin() + sos);
+  joined[sof + 5] = height >> 8;
+  joined[sof + 6] = height & 0xff;
+  const unsigned char dri[] = {0xff, MARKER_DRI, 0, 4,
+                               (unsigned char)(restart_interval >> 8),
+                               (unsigned char)(restart_interval & 0xff)};
+  joined.insert(joined.end(), dri, dri + sizeof(dri));
+  joined.insert(joined.end(), first.begin() + sos, first.begin() + start);
+
+  // Then the data of each band without its EOI, the decoder resets the
+  // DC predictions at each restart marker as an encoder starting on the
+  // band did.
+  for (size_t i = 0; i < bands.size(); ++i)
+  {
+    const std::vector<unsigned char>& band = bands[i];
+    if (i > 0)
+    {
+      joined.push_back(0xff);
+      joined.push_back(MARKER_RST0 + (i - 1) % 8);
+      start = scan_data(band, sof);
+    }
+    joined.insert(joined.end(), band.begin() + start, band.end() - 2);
+  }
+
+  joined.push_back(0xff);
+  joined.push_back(MARKER_EOI);
 
-  FILE* infile;
-  if ((infile = fopen(input_file.c_str(), "rb")) == NULL)
+  return joined;
+}
+} // namespace
+
+std::vector<unsigned char> empdfer::create_jpeg(unsigned char* data,
+                                                long width, long height,
+                                                unsigned components,
+                                                J_COLOR_SPACE color_space,
+                                                int quality,
+                                                ThreadPool* pool)
+{
+  // The size of an MCU depends on how the color space is sampled.
+  jpeg_compress_struct& cinfo = compressor("JPEG encoder");
+  cinfo.input_components = components;
+  cinfo.in_color_space = color_space;
+  jpeg_set_defaults(&cinfo);
+  int max_h = 1, max_v = 1;
+  for (int c = 0; c < cinfo.num_components; ++c)
   {
-    std::cerr << "can't open input file \"" << input_file << "\"" << std::endl;
-    exit(-1);
+    max_h = std::max(max_h, cinfo.comp_info[c].h_samp_factor);
+    max_v = std::max(max_v, cinfo.comp_info[c].v_samp_factor);
   }
 
-  jpeg_stdio_src(&dinfo, infile);
+  // A restart interval counts at most 65535 MCUs.
+  long mcus_per_row = (width + DCTSIZE * max_h - 1) / (DCTSIZE * max_h);
+  long mcu_rows = std::min<long>(band_mcu_rows, 65535 / mcus_per_row);
+  long band_height = mcu_rows * DCTSIZE * max_v;
+  if (mcu_rows == 0 || height <= band_height)
+    return encode(data, width, height, components, color_space, quality);
+
+  size_t row_stride = width * components;
+  std::vector<std::vector<unsigned char>> bands(
+    (height + band_height - 1) / band_height);
+  empdfer::parallel_for(pool, bands.size(), [&](size_t i)
+  {
+    bands[i] = encode(data + i * band_height * row_stride, width,
+                      std::min<long>(band_height, height - i * band_height),
+                      components, color_space, quality);
+  });
+
+  return join_bands(bands, height, mcu_rows * mcus_per_row);
+}
+
+std::vector<unsigned char> empdfer::create_jpeg(const RowSource& rows,
+                                                long width, long height,
+                                                unsigned components,
+                                                J_COLOR_SPACE color_space,
+                                                int quality)
+{
+  jpeg_compress_struct& cinfo = compressor("JPEG encoder");
+  vector_destination_mgr dest;
+  std::vector<unsigned char> compressed;
+
+  vector_dest(&cinfo, &dest, &compressed);
+
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = components;
+  cinfo.in_color_space = color_space;
+
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+
+  jpeg_start_compress(&cinfo, TRUE);
+
+  // libjpeg compresses a row of MCUs at a time, ask for that many rows.
+  unsigned strip = cinfo.max_v_samp_factor * DCTSIZE;
+  size_t row_stride = width * components;
+  std::vector<unsigned char> buffer =
+    empdfer::acquire_buffer(strip * row_stride);
+  std::vector<JSAMPROW> row_pointers(strip);
+  for (unsigned i = 0; i < strip; ++i)
+    row_pointers[i] = buffer.data() + i * row_stride;
+
+  // Only the time spent in libjpeg counts as encoding, the source times
+  // its own work.
+  while (cinfo.next_scanline < cinfo.image_height)
+  {
+    unsigned count = std::min<unsigned>(strip, cinfo.image_height -
+                                               cinfo.next_scanline);
+    rows(buffer.data(), count);
+
+    empdfer::StageTimer timer(empdfer::STAGE_ENCODE);
+    jpeg_write_scanlines(&cinfo, row_pointers.data(), count);
+  }
+
+  empdfer::StageTimer timer(empdfer::STAGE_ENCODE);
+  jpeg_finish_compress(&cinfo);
+  empdfer::release_buffer(std::move(buffer));
+
+  return compressed;
+}
+
+empdfer::Pixels empdfer::decode_jpeg(const Input& input,
+                                     unsigned scale_num)
+{
+  empdfer::StageTimer timer(empdfer::STAGE_DECODE);
+
+  file_ptr infile(NULL, fclose);
+  jpeg_decompress_struct& dinfo = decompressor(input, infile);
   jpeg_read_header(&dinfo, (boolean)0);
-  
+
+  // libjpeg scales in the DCT domain, which is much cheaper than decoding
+  // all the pixels and resampling them.
+  dinfo.scale_num = scale_num;
+  dinfo.scale_denom = 8;
+
   jpeg_start_decompress(&dinfo);
 
+  Pixels pixels;
+  pixels.width = dinfo.output_width;
+  pixels.height = dinfo.output_height;
+  pixels.components = dinfo.output_components;
+
   int row_stride = dinfo.output_width * dinfo.output_components;
-  JSAMPARRAY buffer = (*dinfo.mem->alloc_sarray)((j_common_ptr) &dinfo, JPOOL_IMAGE, row_stride, 1);
-  unsigned char* uncompressed_image = (unsigned char*)malloc(sizeof(unsigned char) * row_stride * dinfo.output_height);
+  JSAMPROW buffer[1];
+  pixels.data = empdfer::acquire_buffer(
+    (size_t)row_stride * dinfo.output_height);
 
   while (dinfo.output_scanline < dinfo.output_height) {
-    buffer[0] = uncompressed_image + dinfo.output_scanline * row_stride;
+    buffer[0] = pixels.data.data() +
+      (size_t)dinfo.output_scanline * row_stride;
     jpeg_read_scanlines(&dinfo, buffer, 1);
   }
 
   jpeg_finish_decompress(&dinfo);
-  fclose(infile);
+  empdfer::count(empdfer::COUNTER_PIXELS,
+                 (uint64_t)pixels.width * pixels.height);
+  count_bytes_read(infile, input);
 
-  create_jpeg(compressed_file, uncompressed_image, dinfo.image_width,
-              dinfo.image_height, dinfo.num_components, dinfo.out_color_space,
-              quality);
-
-  jpeg_destroy_decompress(&dinfo);
+  return pixels;
 }
 
-paddlefish::PagePtr empdfer::jpeg_page(const std::string& input_file,
-                                       double page_x_mm, double page_y_mm,
-                                       double img_x_mm, double img_y_mm,
-                                       int quality, double rotation,
-                                       bool shrink)
+std::vector<unsigned char> empdfer::create_jpeg(const Pixels& pixels,
+                                                int quality,
+                                                ThreadPool* pool)
 {
-  paddlefish::PagePtr p(new paddlefish::Page());
+  return create_jpeg(const_cast<unsigned char*>(pixels.data.data()),
+                     pixels.width, pixels.height, pixels.components,
+                     pixels.components == 1 ? JCS_GRAYSCALE :
+                     pixels.components == 4 ? JCS_CMYK : JCS_RGB,
+                     quality, pool);
+}
 
-  // Compute image size using libjpeg.
-  jpeg_decompress_struct cinfo;
-  struct jpeg_error_mgr err;
+std::vector<unsigned char> empdfer::recompress_jpeg(
+  const Input& input, int quality, unsigned quarter_turns, ThreadPool* pool)
+{
+  Pixels pixels = decode_jpeg(input);
+  if (quarter_turns > 0)
+  {
+    Pixels rotated = empdfer::rotate(pixels, quarter_turns);
+    empdfer::release_buffer(std::move(pixels.data));
+    pixels = std::move(rotated);
+  }
+  std::vector<unsigned char> compressed = create_jpeg(pixels, quality, pool);
+  empdfer::release_buffer(std::move(pixels.data));
+  return compressed;
+}
 
-  jpeg_create_decompress(&cinfo);
-  cinfo.err = jpeg_std_error(&err);
+bool empdfer::transcode_jpeg(const Input& input,
+                             unsigned quarter_turns, int quality,
+                             std::vector<unsigned char>& transcoded)
+{
+  empdfer::StageTimer timer(empdfer::STAGE_TRANSCODE);
+
+  file_ptr infile(NULL, fclose);
+  jpeg_decompress_struct& src = decompressor(input, infile);
+  jpeg_read_header(&src, TRUE);
+
+  // Blocks can only be moved whole, so the edges that end up on the other
+  // side must not have partial MCUs. Turning counter-clockwise by one
+  // quarter reverses the columns, by three quarters the rows.
+  int mcu_x = src.num_components == 1 ? DCTSIZE :
+                                        src.max_h_samp_factor * DCTSIZE;
+  int mcu_y = src.num_components == 1 ? DCTSIZE :
+                                        src.max_v_samp_factor * DCTSIZE;
+  bool reverse_x = quarter_turns == 1 || quarter_turns == 2;
+  bool reverse_y = quarter_turns == 2 || quarter_turns == 3;
+  if ((reverse_x && src.image_width % mcu_x) ||
+      (reverse_y && src.image_height % mcu_y))
+    return false;
+
+  bool transpose = quarter_turns % 2;
+
+  // The arrays for the rotated blocks must be requested before reading the
+  // coefficients, which allocates all of them. Without rotation, the
+  // blocks are changed in place.
+  std::vector<jvirt_barray_ptr> dst_coefs(src.num_components);
+  for (int ci = 0; quarter_turns > 0 && ci < src.num_components; ++ci)
+  {
+    const jpeg_component_info* c = src.comp_info + ci;
+    JDIMENSION w = transpose ? c->height_in_blocks : c->width_in_blocks;
+    JDIMENSION h = transpose ? c->width_in_blocks : c->height_in_blocks;
+    JDIMENSION h_samp = src.num_components == 1 ? 1 :
+                        transpose ? c->v_samp_factor : c->h_samp_factor;
+    JDIMENSION v_samp = src.num_components == 1 ? 1 :
+                        transpose ? c->h_samp_factor : c->v_samp_factor;
+    dst_coefs[ci] = (*src.mem->request_virt_barray)(
+      (j_common_ptr)&src, JPOOL_IMAGE, TRUE,
+      (w + h_samp - 1) / h_samp * h_samp,
+      (h + v_samp - 1) / v_samp * v_samp, v_samp);
+  }
 
-  FILE* infile;
-  if ((infile = fopen(input_file.c_str(), "rb")) == NULL)
+  jvirt_barray_ptr* src_coefs = jpeg_read_coefficients(&src);
+  empdfer::count(empdfer::COUNTER_PIXELS,
+                 (uint64_t)src.image_width * src.image_height);
+  count_bytes_read(infile, input);
+  infile.reset();
+  if (quarter_turns == 0)
+    std::copy(src_coefs, src_coefs + src.num_components, dst_coefs.begin());
+
+  jpeg_compress_struct& dst = compressor(input.name);
+  vector_destination_mgr dest;
+  vector_dest(&dst, &dest, &transcoded);
+
+  jpeg_copy_critical_parameters(&src, &dst);
+  // Lossless transforms keep the file about as small as it was, at the
+  // price of a second pass. Lowering the quality shrinks it anyway, and
+  // is meant to be fast.
+  if (src.progressive_mode)
+    jpeg_simple_progression(&dst);
+  else if (quality == -1)
+    dst.optimize_coding = TRUE;
+
+  // The quantization tables follow the coefficients.
+  if (transpose)
+  {
+    std::swap(dst.image_width, dst.image_height);
+    std::swap(dst.X_density, dst.Y_density);
+    for (int ci = 0; ci < dst.num_components; ++ci)
+      std::swap(dst.comp_info[ci].h_samp_factor,
+                dst.comp_info[ci].v_samp_factor);
+    for (JQUANT_TBL* table : dst.quant_tbl_ptrs)
+      if (table != NULL)
+        for (unsigned i = 0; i < DCTSIZE; ++i)
+          for (unsigned j = 0; j < i; ++j)
+            std::swap(table->quantval[i * DCTSIZE + j],
+                      table->quantval[j * DCTSIZE + i]);
+  }
+  if (dst.num_components == 1)
+    dst.comp_info[0].h_samp_factor = dst.comp_info[0].v_samp_factor = 1;
+
+  // To lower the quality, divide the quantized coefficients by the ratio
+  // of the new quantization steps to the old ones. Steps smaller than the
+  // old ones would not bring back any detail, so those are kept.
+  // jpeg_set_quality() may add tables the source did not have, like the
+  // chroma one for grayscale images. Those keep their new steps.
+  JQUANT_TBL old_tables[NUM_QUANT_TBLS];
+  bool had_table[NUM_QUANT_TBLS] = {};
+  if (quality != -1)
   {
-    std::cerr << "can't open input file \"" << input_file << "\"" << std::endl;
+    for (unsigned t = 0; t < NUM_QUANT_TBLS; ++t)
+      if (dst.quant_tbl_ptrs[t] != NULL)
+      {
+        old_tables[t] = *dst.quant_tbl_ptrs[t];
+        had_table[t] = true;
+      }
+
+    jpeg_set_quality(&dst, quality, TRUE);
+
+    for (unsigned t = 0; t < NUM_QUANT_TBLS; ++t)
+      if (had_table[t])
+        for (unsigned k = 0; k < DCTSIZE2; ++k)
+          dst.quant_tbl_ptrs[t]->quantval[k] =
+            std::max(dst.quant_tbl_ptrs[t]->quantval[k],
+                     old_tables[t].quantval[k]);
+  }
 
-    exit(-1);
+  for (int ci = 0; ci < src.num_components; ++ci)
+  {
+    const jpeg_component_info* c = src.comp_info + ci;
+    long src_w = c->width_in_blocks, src_h = c->height_in_blocks;
+    long src_rows = (src_h + c->v_samp_factor - 1) / c->v_samp_factor *
+                    c->v_samp_factor;
+    long src_cols = (src_w + c->h_samp_factor - 1) / c->h_samp_factor *
+                    c->h_samp_factor;
+    int h_samp = quarter_turns > 0 ? dst.comp_info[ci].h_samp_factor :
+                                     c->h_samp_factor;
+    int v_samp = quarter_turns > 0 ? dst.comp_info[ci].v_samp_factor :
+                                     c->v_samp_factor;
+    long dst_cols = ((transpose ? src_h : src_w) + h_samp - 1) / h_samp *
+                    h_samp;
+    long dst_rows = ((transpose ? src_w : src_h) + v_samp - 1) / v_samp *
+                    v_samp;
+
+    int32_t scales[DCTSIZE2];
+    bool requantize = false;
+    if (quality != -1)
+    {
+      int t = dst.comp_info[ci].quant_tbl_no;
+      const UINT16* old_steps = old_tables[t].quantval;
+      const UINT16* new_steps = dst.quant_tbl_ptrs[t]->quantval;
+      for (unsigned k = 0; k < DCTSIZE2; ++k)
+      {
+        scales[k] = (int32_t)(((int64_t)old_steps[k] << 16) / new_steps[k]);
+        requantize = requantize || old_steps[k] != new_steps[k];
+      }
+    }
+
+    for (long by = 0; by < dst_rows; by += v_samp)
+    {
+      JBLOCKARRAY out = (*src.mem->access_virt_barray)(
+        (j_common_ptr)&src, dst_coefs[ci], by, v_samp, TRUE);
+
+      for (long r = 0; r < v_samp && by + r < dst_rows; ++r)
+        for (long bx = 0; bx < dst_cols; ++bx)
+        {
+          if (quarter_turns > 0)
+          {
+            // Source block of the destination block (bx, by + r).
+            long sx, sy;
+            switch (quarter_turns)
+            {
+              case 1:
+                sx = src_w - 1 - (by + r);
+                sy = bx;
+                break;
+              case 2:
+                sx = src_w - 1 - bx;
+                sy = src_h - 1 - (by + r);
+                break;
+              default:
+                sx = by + r;
+                sy = src_h - 1 - bx;
+                break;
+            }
+            if (sx < 0 || sx >= src_cols || sy < 0 || sy >= src_rows)
+              continue;
+
+            JBLOCKARRAY in = (*src.mem->access_virt_barray)(
+              (j_common_ptr)&src, src_coefs[ci], sy, 1, FALSE);
+            rotate_block(in[0][sx], out[r][bx], quarter_turns);
+          }
+
+          if (requantize)
+            requantize_block(out[r][bx], scales);
+        }
+    }
   }
 
-  jpeg_stdio_src(&cinfo, infile);
+  jpeg_write_coefficients(&dst, dst_coefs.data());
+  jpeg_finish_compress(&dst);
+
+  // The coefficients belong to the decompressor, so it goes last.
+  jpeg_finish_decompress(&src);
+
+  return true;
+}
+
+empdfer::ImageInfo empdfer::probe_jpeg(const Input& input)
+{
+  ImageInfo info;
+  info.type = JPEG;
+
+  // Compute image size using libjpeg.
+  file_ptr infile(NULL, fclose);
+  jpeg_decompress_struct& cinfo = decompressor(input, infile);
   jpeg_read_header(&cinfo, (boolean)0);
-  fclose(infile);
+  infile.reset();
+
+  info.width = cinfo.image_width;
+  info.height = cinfo.image_height;
+  info.components = cinfo.num_components;
+  // Try find which color space the image is in.
+  info.color_space =
+    cinfo.jpeg_color_space == JCS_GRAYSCALE ? DEVICE_GRAY : DEVICE_RGB;
+  info.interlaced = cinfo.progressive_mode;
+
+  // Assume density is specified in DPI. Convert it to dots per mm.
+  info.x_density_dpmm = (double)cinfo.X_density / 25.4;
+  info.y_density_dpmm = (double)cinfo.Y_density / 25.4;
+
+  info.quality = estimate_quality(cinfo);
 
   // Done with libjpeg.
 
-  // Compute the image size based on the resolution in the jpg.
-  if (img_x_mm == -1. && img_y_mm == -1.)
-  {
-    // Assume density is specified in DPI. Convert it to dots per mm.
-    double x_density_dpmm = (double)cinfo.X_density / 25.4;
-    double y_density_dpmm = (double)cinfo.Y_density / 25.4;
+  info.file_size = empdfer::input_size(input);
 
-    img_x_mm = cinfo.image_width / x_density_dpmm;
-    img_y_mm = cinfo.image_height / y_density_dpmm;
-  }
-  // Compute the missing dimensions to maintain aspect ratio in case one size
-  // was not specified.
-  else if (img_x_mm == -1.)
-    img_x_mm = (double)cinfo.image_width * img_y_mm / cinfo.image_height;
-  else
-    img_y_mm = (double)cinfo.image_height * img_x_mm / cinfo.image_width;
+  return info;
+}
 
-  // Set the page size.
-  p->set_mediabox(0, 0, MILIMETERS(page_x_mm), MILIMETERS(page_y_mm));
+empdfer::PageImage empdfer::jpeg_page(const Input& input,
+                                      const ImageInfo& info,
+                                      const ImageOptions& options)
+{
+  PageImage p;
+
+  Image& image = p.image;
+  image.width = info.width;
+  image.height = info.height;
+  image.components = info.components;
+  image.color_space = info.color_space;
+  image.filter = FILTER_DCT;
+
+  int quality = options.quality;
+  if (quality == -1 && options.max_dpi > 0)
+    quality = info.quality;
+
+  empdfer::layout(p, image.width, image.height, info.x_density_dpmm,
+                  info.y_density_dpmm, options);
+
+  // The size in pixels the image would need to be placed at the maximum
+  // resolution.
+  unsigned target_x = image.width, target_y = image.height;
+  if (image.components != 4)
+    empdfer::max_dpi_size(p, image.width, image.height, options.max_dpi,
+                          target_x, target_y);
+
+  bool scale = target_x < image.width || target_y < image.height;
+
+  // Images being encoded anyway are decoded to tell whether their colors
+  // can be reduced. Those embedded as they are stay so.
+  bool reduce = options.gray_tolerance >= 0 && image.components != 4 &&
+                (scale || options.quality != -1);
+  bool threshold = options.threshold >= 0 && image.components != 4;
+
+  // Rotations by quarter turns can be applied to the image itself, so
+  // that viewers do not need to.
+  int turns = options.upright ? empdfer::quarter_turns(options.rotation) : 0;
+  if (turns < 0)
+    turns = 0;
+
+  // Embed the file as it is, or with its DCT blocks moved around.
+  if (!scale && options.quality == -1 && !options.defer_jpeg && !threshold)
+  {
+    if (turns > 0 &&
+        empdfer::transcode_jpeg(input, turns, -1, image.data))
+    {
+      if (turns % 2)
+        std::swap(image.width, image.height);
+      empdfer::layout_upright(p, info.width, info.height,
+                              info.x_density_dpmm, info.y_density_dpmm,
+                              turns, options);
+    }
+    else
+      image.source = input;
+    return p;
+  }
 
-  // Compute the PDF transformation matrix for the image.
-  double matrix23[6];
-  empdfer::fill_matrix(matrix23, img_x_mm, img_y_mm, page_x_mm, page_y_mm,
-                       rotation, shrink);
+  // Encoding only depends on the contents of the file and on these, so
+  // the result of a previous run can be used.
+  std::string key;
+  bool cached = false;
+  if (!options.cache_dir.empty() && !options.defer_jpeg)
+  {
+    empdfer::StageTimer timer(empdfer::STAGE_CACHE);
+    key = empdfer::cache_key(input, "jpeg quality=" +
+                             std::to_string(quality) + " size=" +
+                             std::to_string(target_x) + "x" +
+                             std::to_string(target_y) + " turns=" +
+                             std::to_string(turns) + " gray=" +
+                             std::to_string(reduce ? options.gray_tolerance :
+                                                     -1) + " threshold=" +
+                             std::to_string(threshold ? options.threshold :
+                                                        -1));
+    cached = empdfer::load_cached_image(options.cache_dir, key, image);
+  }
 
-  if (quality == -1)
+  if (cached)
+    ;
+  else if (scale || options.defer_jpeg || reduce || threshold)
   {
-    // Add the jpeg image to the page. For this, try find which color space
-    // the image is in.
-      p->add_jpeg_image(input_file,
-                        cinfo.image_width, cinfo.image_height,
-                        matrix23,
-                        cinfo.jpeg_color_space == JCS_GRAYSCALE ?
-                        COLORSPACE_DEVICEGRAY : COLORSPACE_DEVICERGB);
+    // Decode at the smallest scale libjpeg offers that is still at least
+    // as large as the target, then resample the rest of the way.
+    unsigned scale_num = 1;
+    while (scale_num < 8 &&
+           ((image.width * scale_num + 7) / 8 < target_x ||
+            (image.height * scale_num + 7) / 8 < target_y))
+      ++scale_num;
+
+    Pixels pixels = empdfer::decode_jpeg(input, scale_num);
+    if (pixels.width != target_x || pixels.height != target_y)
+    {
+      Pixels scaled = empdfer::resample(pixels, target_x, target_y);
+      empdfer::release_buffer(std::move(pixels.data));
+      pixels = std::move(scaled);
+    }
+    if (turns > 0)
+    {
+      Pixels rotated = empdfer::rotate(pixels, turns);
+      empdfer::release_buffer(std::move(pixels.data));
+      pixels = std::move(rotated);
+    }
+
+    image.width = pixels.width;
+    image.height = pixels.height;
+    if (reduce && empdfer::reduce_to_gray(pixels, options.gray_tolerance))
+    {
+      image.components = 1;
+      image.color_space = DEVICE_GRAY;
+    }
+
+    if (threshold)
+    {
+      empdfer::threshold_image(image, pixels, options.threshold);
+      empdfer::release_buffer(std::move(pixels.data));
+    }
+    else if (reduce && pixels.components == 1 &&
+             empdfer::bilevel_image(image, pixels.data.data(),
+                                    options.gray_tolerance))
+      empdfer::release_buffer(std::move(pixels.data));
+    else if (options.defer_jpeg)
+      image.pixels = std::make_shared<Pixels>(std::move(pixels));
+    else
+    {
+      image.data = empdfer::create_jpeg(pixels, quality, options.pool);
+      empdfer::release_buffer(std::move(pixels.data));
+    }
   }
   else
   {
-    std::string compressed_file =
-      std::filesystem::temp_directory_path().string() + "/" + input_file +
-      "_compressed_" + std::to_string(quality);
-
-    empdfer::recompress_jpeg(input_file, compressed_file, quality);
+    // Lower the quality without decoding, unless the rotation cannot be
+    // done that way.
+    if (!empdfer::transcode_jpeg(input, turns, quality, image.data))
+      image.data = empdfer::recompress_jpeg(input, quality, turns,
+                                            options.pool);
+    if (turns % 2)
+      std::swap(image.width, image.height);
+  }
 
-    // Add the recompressed image.
-    p->add_jpeg_image(compressed_file, cinfo.image_width, cinfo.image_height,
-                      matrix23,
-                      cinfo.jpeg_color_space == JCS_GRAYSCALE ?
-                      COLORSPACE_DEVICEGRAY : COLORSPACE_DEVICERGB);
+  if (!key.empty() && !cached)
+  {
+    empdfer::StageTimer timer(empdfer::STAGE_CACHE);
+    empdfer::store_cached_image(options.cache_dir, key, image);
   }
 
+  // The pixels are already rotated, the page should not rotate them again.
+  if (turns > 0)
+    empdfer::layout_upright(p, info.width, info.height, info.x_density_dpmm,
+                            info.y_density_dpmm, turns, options);
+
   return p;
 }
@@ -18,20 +18,58 @@
 #ifndef EMPDFER_JPEG_FILE_H
 #define EMPDFER_JPEG_FILE_H
 
+#include <cstdio>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include <jpeglib.h>
-#include <paddlefish/paddlefish.h>
+
+#include "image.h"
+#include "pixels.h"
+#include "thread_pool.h"
 
 namespace empdfer {
 
-void create_jpeg(const std::string&, unsigned char*, long, long, unsigned,
-                 J_COLOR_SPACE, int);
+// Encodes the pixels with the given quality and returns the JPEG bytes.
+// Tall images are encoded in bands, with restart markers between them,
+// and the bands are shared with the workers of the pool, if any.
+std::vector<unsigned char> create_jpeg(unsigned char*, long, long, unsigned,
+                                       J_COLOR_SPACE, int,
+                                       ThreadPool* pool = NULL);
+
+std::vector<unsigned char> create_jpeg(const Pixels&, int,
+                                       ThreadPool* pool = NULL);
+
+// Fills the buffer with the next count rows of an image, packed.
+typedef std::function<void(unsigned char*, unsigned count)> RowSource;
+
+// Same, asking for the rows a strip at a time, so that only a strip of
+// the image needs to be in memory.
+std::vector<unsigned char> create_jpeg(const RowSource&, long, long, unsigned,
+                                       J_COLOR_SPACE, int);
+
+// Decodes the input, scaled by scale_num / 8.
+Pixels decode_jpeg(const Input&, unsigned scale_num = 8);
+
+// Decodes the input, rotates it counter-clockwise by the given number of
+// quarter turns and encodes it again with the given quality.
+std::vector<unsigned char> recompress_jpeg(const Input&, int,
+                                           unsigned quarter_turns = 0,
+                                           ThreadPool* pool = NULL);
+
+// Transforms the input without decoding it. Rotates it counter-clockwise by
+// quarter_turns, moving the DCT blocks around like jpegtran does, and,
+// unless quality is -1, quantizes the coefficients again with the tables
+// of that quality. Returns false, leaving transcoded untouched, when the
+// image has partial blocks on an edge that would need to move.
+bool transcode_jpeg(const Input&, unsigned quarter_turns, int quality,
+                    std::vector<unsigned char>& transcoded);
 
-void recompress_jpeg(const std::string&, const std::string&, int);
+// Reads the header of the input.
+ImageInfo probe_jpeg(const Input&);
 
-paddlefish::PagePtr jpeg_page(const std::string&, double, double, double,
-                              double, int, double, bool);
+PageImage jpeg_page(const Input&, const ImageInfo&, const ImageOptions&);
 } // namespace empdfer
 
 #endif // EMPDFER_JPEG_FILE_H
@@ -0,0 +1,385 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "json.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+const char* const base64_digits =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+class Parser
+{
+public:
+    explicit Parser(const std::string& text) :
+        text_(text), pos_(0), depth_(0) {}
+
+    empdfer::JsonValue parse()
+    {
+        empdfer::JsonValue v = value();
+        skip_space();
+        if (pos_ != text_.size())
+            fail("unexpected text after the value");
+        return v;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what)
+    {
+        throw std::runtime_error("invalid JSON at offset " +
+                                 std::to_string(pos_) + ": " + what);
+    }
+
+    void skip_space()
+    {
+        while (pos_ < text_.size() && strchr(" \t\r\n", text_[pos_]))
+            ++pos_;
+    }
+
+    bool next_is(char c)
+    {
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == c)
+        {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!next_is(c))
+            fail(std::string("expected '") + c + "'");
+    }
+
+    bool next_word(const char* word)
+    {
+        size_t n = strlen(word);
+        if (text_.compare(pos_, n, word) != 0)
+            return false;
+        pos_ += n;
+        return true;
+    }
+
+    empdfer::JsonValue value()
+    {
+        empdfer::JsonValue v;
+        skip_space();
+        if (pos_ == text_.size())
+            fail("unexpected end of text");
+
+        // Bound the recursion, the text may come from anywhere.
+        if (depth_ == 64)
+            fail("too deeply nested");
+
+        char c = text_[pos_];
+        if (c == '{' || c == '[')
+            ++depth_;
+        if (c == '{')
+        {
+            ++pos_;
+            v.type = empdfer::JsonValue::JSON_OBJECT;
+            if (next_is('}'))
+            {
+                --depth_;
+                return v;
+            }
+            do
+            {
+                skip_space();
+                std::string name = string();
+                expect(':');
+                v.object.emplace_back(name, value());
+            } while (next_is(','));
+            expect('}');
+            --depth_;
+        }
+        else if (c == '[')
+        {
+            ++pos_;
+            v.type = empdfer::JsonValue::JSON_ARRAY;
+            if (next_is(']'))
+            {
+                --depth_;
+                return v;
+            }
+            do
+                v.array.push_back(value());
+            while (next_is(','));
+            expect(']');
+            --depth_;
+        }
+        else if (c == '"')
+        {
+            v.type = empdfer::JsonValue::JSON_STRING;
+            v.string = string();
+        }
+        else if (next_word("true") || next_word("false"))
+        {
+            v.type = empdfer::JsonValue::JSON_BOOLEAN;
+            v.boolean = c == 't';
+        }
+        else if (next_word("null"))
+            ;
+        else
+        {
+            const char* begin = text_.c_str() + pos_;
+            char* end;
+            v.type = empdfer::JsonValue::JSON_NUMBER;
+            v.number = strtod(begin, &end);
+            if (end == begin)
+                fail("unexpected character");
+            // strtod() also reads nan and inf, and overflows to inf.
+            if (!std::isfinite(v.number))
+                fail("number out of range");
+            pos_ += end - begin;
+        }
+        return v;
+    }
+
+    std::string string()
+    {
+        if (pos_ == text_.size() || text_[pos_] != '"')
+            fail("expected a string");
+        ++pos_;
+
+        std::string s;
+        while (true)
+        {
+            if (pos_ == text_.size())
+                fail("unterminated string");
+
+            char c = text_[pos_++];
+            if (c == '"')
+                return s;
+            if (c != '\\')
+            {
+                s += c;
+                continue;
+            }
+
+            if (pos_ == text_.size())
+                fail("unterminated string");
+            c = text_[pos_++];
+            switch (c)
+            {
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'n': s += '\n'; break;
+                case 'r': s += '\r'; break;
+                case 't': s += '\t'; break;
+                case 'u': utf8(s, code_unit()); break;
+                default: s += c; break;
+            }
+        }
+    }
+
+    unsigned code_unit()
+    {
+        if (text_.size() - pos_ < 4)
+            fail("truncated escape");
+        // Exactly four hexadecimal digits, which strtoul alone would not
+        // check: it takes signs, spaces and a 0x prefix.
+        char digits[5] = {0};
+        memcpy(digits, text_.c_str() + pos_, 4);
+        for (int i = 0; i < 4; ++i)
+            if (!isxdigit((unsigned char)digits[i]))
+                fail("invalid escape");
+        pos_ += 4;
+        return strtoul(digits, NULL, 16);
+    }
+
+    void utf8(std::string& s, unsigned u)
+    {
+        // A high surrogate is followed by the escape of a low one. Either
+        // alone is not a character, and has no UTF-8 encoding.
+        if (u >= 0xdc00 && u < 0xe000)
+            fail("unpaired surrogate");
+        if (u >= 0xd800 && u < 0xdc00)
+        {
+            unsigned low = 0;
+            if (next_word("\\u"))
+                low = code_unit();
+            if (low < 0xdc00 || low >= 0xe000)
+                fail("unpaired surrogate");
+            u = 0x10000 + ((u - 0xd800) << 10) + (low - 0xdc00);
+        }
+
+        if (u < 0x80)
+            s += (char)u;
+        else if (u < 0x800)
+        {
+            s += (char)(0xc0 | u >> 6);
+            s += (char)(0x80 | (u & 0x3f));
+        }
+        else if (u < 0x10000)
+        {
+            s += (char)(0xe0 | u >> 12);
+            s += (char)(0x80 | ((u >> 6) & 0x3f));
+            s += (char)(0x80 | (u & 0x3f));
+        }
+        else
+        {
+            s += (char)(0xf0 | u >> 18);
+            s += (char)(0x80 | ((u >> 12) & 0x3f));
+            s += (char)(0x80 | ((u >> 6) & 0x3f));
+            s += (char)(0x80 | (u & 0x3f));
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_;
+    unsigned depth_;
+};
+} // namespace
+
+const empdfer::JsonValue* empdfer::JsonValue::find(
+    const std::string& name) const
+{
+    for (const auto& member : object)
+        if (member.first == name)
+            return &member.second;
+    return NULL;
+}
+
+empdfer::JsonValue empdfer::parse_json(const std::string& text)
+{
+    return Parser(text).parse();
+}
+
+std::string empdfer::json_text(const JsonValue& v)
+{
+    switch (v.type)
+    {
+        case JsonValue::JSON_BOOLEAN:
+            return v.boolean ? "true" : "false";
+        case JsonValue::JSON_NUMBER:
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", v.number);
+            return buf;
+        }
+        case JsonValue::JSON_STRING:
+            return json_string(v.string);
+        case JsonValue::JSON_ARRAY:
+        {
+            std::string s = "[";
+            for (size_t i = 0; i < v.array.size(); ++i)
+                s += (i ? ", " : "") + json_text(v.array[i]);
+            return s + "]";
+        }
+        case JsonValue::JSON_OBJECT:
+        {
+            std::string s = "{";
+            for (size_t i = 0; i < v.object.size(); ++i)
+                s += (i ? ", " : "") + json_string(v.object[i].first) +
+                     ": " + json_text(v.object[i].second);
+            return s + "}";
+        }
+        default:
+            return "null";
+    }
+}
+
+std::string empdfer::json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for (unsigned char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else
+            out += c;
+    }
+    return out + "\"";
+}
+
+std::string empdfer::base64_encode(const unsigned char* data, size_t size)
+{
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+
+    for (size_t i = 0; i < size; i += 3)
+    {
+        unsigned long group = (unsigned long)data[i] << 16;
+        if (i + 1 < size)
+            group |= (unsigned long)data[i + 1] << 8;
+        if (i + 2 < size)
+            group |= data[i + 2];
+
+        out += base64_digits[group >> 18];
+        out += base64_digits[(group >> 12) & 0x3f];
+        out += i + 1 < size ? base64_digits[(group >> 6) & 0x3f] : '=';
+        out += i + 2 < size ? base64_digits[group & 0x3f] : '=';
+    }
+
+    return out;
+}
+
+std::vector<unsigned char> empdfer::base64_decode(const std::string& text)
+{
+    signed char values[256];
+    memset(values, -1, sizeof(values));
+    for (int i = 0; i < 64; ++i)
+        values[(unsigned char)base64_digits[i]] = i;
+
+    std::vector<unsigned char> out;
+    out.reserve(text.size() / 4 * 3);
+
+    unsigned long group = 0;
+    unsigned bits = 0;
+    size_t padding = 0;
+    for (unsigned char c : text)
+    {
+        if (c == '=')
+        {
+            ++padding;
+            continue;
+        }
+        if (values[c] < 0 || padding)
+            throw std::runtime_error("invalid base64 data");
+
+        group = (group << 6) | values[c];
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back((group >> bits) & 0xff);
+        }
+    }
+
+    if (padding > 2 || bits >= 6)
+        throw std::runtime_error("invalid base64 data");
+
+    return out;
+}
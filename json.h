@@ -0,0 +1,69 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_JSON_H
+#define EMPDFER_JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace empdfer {
+
+// A JSON value, as read from jobs and manifests.
+struct JsonValue
+{
+    enum Type
+    {
+        JSON_NULL,
+        JSON_BOOLEAN,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    Type type = JSON_NULL;
+    bool boolean = false;
+    double number = 0.;
+    std::string string;
+    std::vector<JsonValue> array;
+    // Members of an object, in the order they were read.
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    // Member of an object with the given name, NULL if there is none.
+    const JsonValue* find(const std::string&) const;
+};
+
+// Parses a whole JSON text. Throws std::runtime_error if it is not valid.
+JsonValue parse_json(const std::string&);
+
+// Writes the value as JSON text.
+std::string json_text(const JsonValue&);
+
+// Quotes the string, escaping what JSON requires.
+std::string json_string(const std::string&);
+
+// Binary data travels in JSON strings encoded as base64.
+std::string base64_encode(const unsigned char*, size_t);
+
+// Throws std::runtime_error if the text is not valid base64.
+std::vector<unsigned char> base64_decode(const std::string&);
+
+} // namespace empdfer
+
+#endif // EMPDFER_JSON_H
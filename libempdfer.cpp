@@ -0,0 +1,111 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "libempdfer.h"
+#include "create_page.h"
+#include "pdf_writer.h"
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace {
+// Collects the output in chunks, so that the sink is not called for each
+// of the small pieces the writer produces.
+class SinkStreamBuf : public std::streambuf
+{
+public:
+    explicit SinkStreamBuf(const empdfer::Sink& sink) :
+        sink_(sink), buffer_(64 * 1024)
+    {
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        sync();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        if (pptr() > pbase())
+            sink_(pbase(), pptr() - pbase());
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        return 0;
+    }
+
+private:
+    const empdfer::Sink& sink_;
+    std::vector<char> buffer_;
+};
+} // namespace
+
+empdfer::Document::Document(Sink sink, ThreadPool* pool) :
+    sink_(sink), pool_(pool)
+{
+}
+
+void empdfer::Document::add_page(const Input& input,
+                                 const ImageOptions& options)
+{
+    inputs_.push_back(input);
+    if (inputs_.back().name.empty())
+        inputs_.back().name = "image " + std::to_string(inputs_.size());
+
+    // The writer takes Flate data as PNG files store it.
+    options_.push_back(options);
+    options_.back().embed_flate = true;
+    options_.back().pool = pool_;
+}
+
+void empdfer::Document::add_page(std::vector<unsigned char>&& bytes,
+                                 const ImageOptions& options)
+{
+    owned_.push_back(std::move(bytes));
+    add_page(Input(std::string(), owned_.back().data(), owned_.back().size()),
+             options);
+}
+
+void empdfer::Document::finish()
+{
+    SinkStreamBuf buffer(sink_);
+    std::ostream out(&buffer);
+    PdfWriter w(out);
+
+    // Keep only a few pages in flight, as the command line does when
+    // streaming.
+    size_t window = pool_ ? 2 * pool_->size() : 1;
+    ordered_for_each(pool_, inputs_.size(), window,
+        [&](size_t i)
+        {
+            PageImage p = create_page(inputs_[i], options_[i]);
+            deflate_image(p.image, options_[i]);
+            digest_image(p.image);
+            return p;
+        },
+        [&](PageImage&& p) { w.write_page(p); });
+
+    w.finish();
+    out.flush();
+}
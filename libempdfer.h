@@ -0,0 +1,77 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_LIBEMPDFER_H
+#define EMPDFER_LIBEMPDFER_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "image.h"
+#include "input.h"
+#include "thread_pool.h"
+
+namespace empdfer {
+
+// Receives the bytes of a document, in order, as they are produced.
+typedef std::function<void(const char*, size_t)> Sink;
+
+// Builds a PDF document with a page for each image, from image files or
+// bytes in memory, and hands it to a sink. Nothing is written to disk,
+// unless the options of a page name a cache directory.
+//
+//     empdfer::Document d(sink);
+//     d.add_page(std::move(jpeg_bytes));
+//     d.add_page(empdfer::Input("scan", png_data, png_size), options);
+//     d.finish();
+class Document
+{
+public:
+    // Pages are built on the pool, if any, which can be shared by several
+    // documents and must outlive this one.
+    explicit Document(Sink sink, ThreadPool* pool = NULL);
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    // Adds a page showing the image of the input. Bytes in memory must be
+    // kept by the caller until finish() returns.
+    void add_page(const Input&, const ImageOptions& = ImageOptions());
+
+    // Adds a page showing the image in the bytes, which the document keeps.
+    void add_page(std::vector<unsigned char>&&,
+                  const ImageOptions& = ImageOptions());
+
+    // Builds the pages and writes the whole document to the sink. Throws
+    // std::runtime_error if an image cannot be read.
+    void finish();
+
+private:
+    Sink sink_;
+    ThreadPool* pool_;
+    std::vector<Input> inputs_;
+    std::vector<ImageOptions> options_;
+    // Bytes given to the document. A deque never moves its elements, so
+    // the inputs can point to them.
+    std::deque<std::vector<unsigned char>> owned_;
+};
+
+} // namespace empdfer
+
+#endif // EMPDFER_LIBEMPDFER_H
@@ -0,0 +1,170 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "manifest.h"
+#include "create_page.h"
+#include "job.h"
+#include "json.h"
+#include "pdf_writer.h"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// A page built on a worker, or why it could not be.
+struct BuiltPage
+{
+    empdfer::PageImage page;
+    std::string error;
+};
+
+// The document being written, only one at a time.
+struct Output
+{
+    std::ofstream file;
+    std::unique_ptr<empdfer::PdfWriter> writer;
+    bool failed = false;
+};
+} // namespace
+
+size_t empdfer::run_manifest(std::istream& manifest,
+                             const ImageOptions& defaults, ThreadPool* pool,
+                             std::ostream& errors)
+{
+    // The writer takes Flate data as PNG files store it.
+    ImageOptions options = defaults;
+    options.embed_flate = true;
+    options.pool = pool;
+
+    std::vector<Job> jobs;
+    size_t failed = 0;
+    std::string line;
+    for (size_t n = 1; std::getline(manifest, line); ++n)
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        try
+        {
+            Job job = parse_job(parse_json(line), options);
+            if (job.output.empty())
+                throw std::runtime_error("job: no \"output\"");
+            jobs.push_back(std::move(job));
+        }
+        catch (const std::exception& e)
+        {
+            errors << "manifest line " << n << ": " << e.what() << std::endl;
+            ++failed;
+        }
+    }
+
+    // All the pages, document after document.
+    std::vector<std::pair<size_t, size_t>> pages;
+    std::vector<std::vector<Input>> inputs(jobs.size());
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        for (JobPage& p : jobs[j].pages)
+        {
+            inputs[j].push_back(p.input);
+            if (p.input.empty())
+                inputs[j].back() =
+                    Input("image " + std::to_string(inputs[j].size()),
+                          p.data.data(), p.data.size());
+            pages.push_back(std::make_pair(j, inputs[j].size() - 1));
+        }
+    }
+
+    Output out;
+    size_t written = 0;
+    auto fail = [&](const Job& job, const std::string& error)
+    {
+        errors << job.output << ": " << error << std::endl;
+        // Do not leave half a document behind.
+        if (out.writer)
+        {
+            out.writer.reset();
+            out.file.close();
+            std::remove(job.output.c_str());
+        }
+        out.failed = true;
+        ++failed;
+    };
+
+    // The window spans several documents, so that the workers do not wait
+    // for each document to be written before starting on the next one.
+    size_t window = pool ? 2 * pool->size() : 1;
+    ordered_for_each(pool, pages.size(), window,
+        [&](size_t i)
+        {
+            const Job& job = jobs[pages[i].first];
+            size_t k = pages[i].second;
+            BuiltPage b;
+            try
+            {
+                b.page = create_page(inputs[pages[i].first][k],
+                                     job.pages[k].options);
+                deflate_image(b.page.image, job.pages[k].options);
+                digest_image(b.page.image);
+            }
+            catch (const std::exception& e)
+            {
+                b.error = e.what();
+            }
+            return b;
+        },
+        [&](BuiltPage&& b)
+        {
+            Job& job = jobs[pages[written].first];
+            size_t k = pages[written++].second;
+
+            if (k == 0)
+            {
+                out.failed = false;
+                out.file.open(job.output,
+                              std::ios_base::out|std::ios_base::binary);
+                if (out.file)
+                    out.writer.reset(new PdfWriter(out.file));
+                else
+                    fail(job, "can't open output file");
+            }
+
+            if (!out.failed && !b.error.empty())
+                fail(job, b.error);
+            if (out.failed)
+                return;
+
+            out.writer->write_page(b.page);
+            // The workers are done with the bytes of the page.
+            std::vector<unsigned char>().swap(job.pages[k].data);
+
+            if (k + 1 == job.pages.size())
+            {
+                out.writer->finish();
+                out.file.close();
+                if (!out.file)
+                    fail(job, "can't write output file");
+                out.writer.reset();
+            }
+        });
+
+    return failed;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_MANIFEST_H
+#define EMPDFER_MANIFEST_H
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+#include "image.h"
+#include "thread_pool.h"
+
+namespace empdfer {
+
+// Builds many documents in one run. The manifest has a job (see job.h) on
+// each line, and each job must name its output file:
+//
+//     {"output": "a.pdf", "pages": [{"file": "1.jpg", "rotation": 90}]}
+//     {"output": "b.pdf", "quality": 60, "pages": [{"file": "2.png"}]}
+//
+// The pages of all the documents are built on the same pool, so that the
+// workers move on to the next documents while one is being written, and
+// share their codec state and the cache directory, if any, among all of
+// them. A document that cannot be built is reported to errors and left
+// out, without stopping the others. Returns the number of such documents.
+size_t run_manifest(std::istream& manifest, const ImageOptions& defaults,
+                    ThreadPool* pool, std::ostream& errors);
+
+} // namespace empdfer
+
+#endif // EMPDFER_MANIFEST_H
@@ -0,0 +1,240 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pdf_writer.h"
+#include "stats.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <fstream>
+
+namespace {
+// PDF does not accept exponents in real numbers, so print them in fixed
+// notation and remove the trailing zeros.
+std::string number(double x)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.4f", x);
+    std::string s(buf);
+    s.erase(s.find_last_not_of('0') + 1);
+    if (s.back() == '.')
+        s.pop_back();
+    if (s == "-0")
+        s = "0";
+    return s;
+}
+
+std::string reference(unsigned object)
+{
+    return std::to_string(object) + " 0 R";
+}
+
+const char* color_space_name(empdfer::ColorSpace cs)
+{
+    return cs == empdfer::DEVICE_GRAY ? "/DeviceGray" : "/DeviceRGB";
+}
+
+// Millimeters to PDF units.
+double points(double mm)
+{
+    return mm * 72. / 25.4;
+}
+} // namespace
+
+empdfer::PdfWriter::PdfWriter(std::ostream& out) : out_(out), offset_(0)
+{
+    // The binary comment tells transfer programs the file is not text.
+    write("%PDF-1.5\n%\xe2\xe3\xcf\xd3\n");
+
+    catalog_ = new_object();
+    page_tree_ = new_object();
+}
+
+unsigned empdfer::PdfWriter::new_object()
+{
+    objects_.push_back(0);
+    return objects_.size();
+}
+
+void empdfer::PdfWriter::begin_object(unsigned object)
+{
+    objects_[object - 1] = offset_;
+    write(std::to_string(object) + " 0 obj\n");
+}
+
+void empdfer::PdfWriter::end_object()
+{
+    write("endobj\n");
+}
+
+void empdfer::PdfWriter::write(const char* bytes, size_t size)
+{
+    out_.write(bytes, size);
+    offset_ += size;
+}
+
+void empdfer::PdfWriter::write(const std::string& s)
+{
+    write(s.data(), s.size());
+}
+
+unsigned empdfer::PdfWriter::write_image(const Image& image)
+{
+    if (!image.digest.empty())
+    {
+        auto i = images_.find(image.digest);
+        if (i != images_.end())
+            return i->second;
+    }
+
+    unsigned mask = image.mask ? write_image(*image.mask) : 0;
+
+    size_t length = image.source.empty() ?
+        image.data.size() : empdfer::input_size(image.source);
+
+    std::string dict = "<< /Type /XObject /Subtype /Image";
+    dict += " /Width " + std::to_string(image.width);
+    dict += " /Height " + std::to_string(image.height);
+    dict += " /ColorSpace ";
+    dict += color_space_name(image.color_space);
+    dict += " /BitsPerComponent " + std::to_string(image.bits_per_component);
+    switch (image.filter)
+    {
+        case FILTER_FLATE:
+            dict += " /Filter /FlateDecode";
+            if (image.predictor)
+                dict += " /DecodeParms << /Predictor " +
+                        std::to_string(image.predictor) + " /Colors " +
+                        std::to_string(image.components) +
+                        " /BitsPerComponent " +
+                        std::to_string(image.bits_per_component) +
+                        " /Columns " + std::to_string(image.width) + " >>";
+            break;
+        case FILTER_DCT:
+            dict += " /Filter /DCTDecode";
+            break;
+        case FILTER_CCITT:
+            dict += " /Filter /CCITTFaxDecode /DecodeParms << /K -1";
+            dict += " /Columns " + std::to_string(image.width) + " /Rows " +
+                    std::to_string(image.height) + " >>";
+            break;
+        default:
+            break;
+    }
+    if (mask)
+        dict += " /SMask " + reference(mask);
+    dict += " /Length " + std::to_string(length) + " >>\nstream\n";
+
+    unsigned object = new_object();
+    begin_object(object);
+    write(dict);
+
+    if (image.source.empty())
+        write((const char*)image.data.data(), image.data.size());
+    else if (image.source.in_memory())
+        write((const char*)image.source.data, image.source.size);
+    else
+    {
+        // Copy the file in chunks, there is no need to hold it in memory.
+        const std::string& file = image.source.name;
+        std::ifstream f(file, std::ios_base::in|std::ios_base::binary);
+        if (!f)
+            throw std::runtime_error(file + ": can't open input file");
+
+        std::vector<char> buffer(64 * 1024);
+        size_t copied = 0;
+        while (f.read(buffer.data(), buffer.size()) || f.gcount() > 0)
+        {
+            write(buffer.data(), f.gcount());
+            copied += f.gcount();
+        }
+        if (copied != length)
+            throw std::runtime_error(file + ": file changed while read");
+        count(COUNTER_BYTES_READ, copied);
+    }
+
+    write("\nendstream\n");
+    end_object();
+
+    if (!image.digest.empty())
+        images_[image.digest] = object;
+
+    return object;
+}
+
+void empdfer::PdfWriter::write_page(const PageImage& p)
+{
+    unsigned image = write_image(p.image);
+
+    std::string content = "q";
+    for (unsigned i = 0; i < 6; ++i)
+        content += " " + number(p.matrix23[i]);
+    content += " cm /Im0 Do Q\n";
+
+    unsigned contents = new_object();
+    begin_object(contents);
+    write("<< /Length " + std::to_string(content.size()) + " >>\nstream\n");
+    write(content);
+    write("endstream\n");
+    end_object();
+
+    unsigned page = new_object();
+    begin_object(page);
+    write("<< /Type /Page /Parent " + reference(page_tree_) +
+          " /MediaBox [0 0 " + number(points(p.page_x_mm)) + " " +
+          number(points(p.page_y_mm)) + "] /Resources << /XObject << /Im0 " +
+          reference(image) + " >> >> /Contents " + reference(contents) +
+          " >>\n");
+    end_object();
+
+    pages_.push_back(page);
+
+    out_.flush();
+}
+
+void empdfer::PdfWriter::finish()
+{
+    std::string kids;
+    for (auto page : pages_)
+        kids += (kids.empty() ? "" : " ") + reference(page);
+
+    begin_object(page_tree_);
+    write("<< /Type /Pages /Kids [" + kids + "] /Count " +
+          std::to_string(pages_.size()) + " >>\n");
+    end_object();
+
+    begin_object(catalog_);
+    write("<< /Type /Catalog /Pages " + reference(page_tree_) + " >>\n");
+    end_object();
+
+    // Each entry of the cross-reference table is exactly 20 bytes long.
+    size_t xref = offset_;
+    write("xref\n0 " + std::to_string(objects_.size() + 1) + "\n");
+    write("0000000000 65535 f \n");
+    for (auto offset : objects_)
+    {
+        char entry[21];
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        write(entry, 20);
+    }
+
+    write("trailer\n<< /Size " + std::to_string(objects_.size() + 1) +
+          " /Root " + reference(catalog_) + " >>\nstartxref\n" +
+          std::to_string(xref) + "\n%%EOF\n");
+
+    out_.flush();
+}
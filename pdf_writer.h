@@ -0,0 +1,67 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_PDF_WRITER_H
+#define EMPDFER_PDF_WRITER_H
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "image.h"
+
+namespace empdfer {
+
+// Writes a PDF document page by page. Each page, together with its image,
+// goes to the output as soon as write_page() is called, so the caller can
+// release it right away. Only the offsets of the objects are kept until
+// finish() writes the page tree, the cross-reference table and the trailer.
+// Images with a digest are written once, and pages showing the same image
+// again refer to the first copy.
+class PdfWriter
+{
+public:
+    explicit PdfWriter(std::ostream&);
+
+    void write_page(const PageImage&);
+    void finish();
+
+private:
+    unsigned new_object();
+    void begin_object(unsigned);
+    void end_object();
+    unsigned write_image(const Image&);
+
+    void write(const char*, size_t);
+    void write(const std::string&);
+
+    std::ostream& out_;
+    size_t offset_;
+    // Offset of each object, indexed by object number minus one.
+    std::vector<size_t> objects_;
+    std::vector<unsigned> pages_;
+    // Object of each image written, by digest.
+    std::map<std::string, unsigned> images_;
+    unsigned catalog_;
+    unsigned page_tree_;
+};
+
+} // namespace empdfer
+
+#endif // EMPDFER_PDF_WRITER_H
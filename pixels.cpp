@@ -0,0 +1,627 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "buffer_pool.h"
+#include "pixels.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+struct Contribution
+{
+    unsigned source;
+    float weight;
+};
+
+// For each of the to destination samples, the source samples it covers
+// and how much of each. The weights of each destination sample add to one.
+std::vector<std::vector<Contribution>> contributions(unsigned from,
+                                                     unsigned to)
+{
+    std::vector<std::vector<Contribution>> c(to);
+    double ratio = (double)from / to;
+
+    for (unsigned i = 0; i < to; ++i)
+    {
+        double start = i * ratio;
+        double end = std::min((i + 1) * ratio, (double)from);
+
+        for (unsigned s = (unsigned)start; s < end; ++s)
+        {
+            double w = std::min(end, s + 1.) - std::max(start, (double)s);
+            if (w > 0.)
+                c[i].push_back({s, (float)(w / ratio)});
+        }
+    }
+
+    return c;
+}
+} // namespace
+
+empdfer::Pixels empdfer::resample(const Pixels& src, unsigned width,
+                                  unsigned height)
+{
+    StageTimer timer(STAGE_TRANSFORM);
+
+    const unsigned comps = src.components;
+    auto cx = contributions(src.width, width);
+    auto cy = contributions(src.height, height);
+
+    // Horizontal pass, keeping the intermediate values as floats.
+    std::vector<float> rows((size_t)width * src.height * comps);
+    for (unsigned y = 0; y < src.height; ++y)
+    {
+        const unsigned char* in = src.data.data() + (size_t)y * src.width * comps;
+        float* out = rows.data() + (size_t)y * width * comps;
+
+        for (unsigned x = 0; x < width; ++x)
+            for (const auto& c : cx[x])
+                for (unsigned k = 0; k < comps; ++k)
+                    out[x * comps + k] += c.weight * in[c.source * comps + k];
+    }
+
+    // Vertical pass.
+    Pixels dst;
+    dst.width = width;
+    dst.height = height;
+    dst.components = comps;
+    dst.data = empdfer::acquire_buffer((size_t)width * height * comps);
+
+    std::vector<float> acc((size_t)width * comps);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        std::fill(acc.begin(), acc.end(), 0.f);
+
+        for (const auto& c : cy[y])
+        {
+            const float* in = rows.data() + (size_t)c.source * width * comps;
+            for (size_t i = 0; i < acc.size(); ++i)
+                acc[i] += c.weight * in[i];
+        }
+
+        unsigned char* out = dst.data.data() + (size_t)y * width * comps;
+        for (size_t i = 0; i < acc.size(); ++i)
+        {
+            long v = std::lround(acc[i]);
+            out[i] = (unsigned char)(v > 255 ? 255 : v);
+        }
+    }
+
+    return dst;
+}
+
+empdfer::Pixels empdfer::rotate(const Pixels& src, unsigned quarter_turns)
+{
+    StageTimer timer(STAGE_TRANSFORM);
+
+    const unsigned comps = src.components;
+    const unsigned w = src.width, h = src.height;
+    quarter_turns %= 4;
+
+    Pixels dst;
+    dst.width = quarter_turns % 2 ? h : w;
+    dst.height = quarter_turns % 2 ? w : h;
+    dst.components = comps;
+    dst.data = empdfer::acquire_buffer((size_t)w * h * comps);
+
+    for (unsigned y = 0; y < dst.height; ++y)
+    {
+        unsigned char* out = dst.data.data() + (size_t)y * dst.width * comps;
+
+        for (unsigned x = 0; x < dst.width; ++x, out += comps)
+        {
+            // Source pixel of the destination pixel (x, y).
+            unsigned sx, sy;
+            switch (quarter_turns)
+            {
+                case 1:
+                    sx = w - 1 - y;
+                    sy = x;
+                    break;
+                case 2:
+                    sx = w - 1 - x;
+                    sy = h - 1 - y;
+                    break;
+                case 3:
+                    sx = y;
+                    sy = h - 1 - x;
+                    break;
+                default:
+                    sx = x;
+                    sy = y;
+                    break;
+            }
+
+            const unsigned char* in =
+                src.data.data() + ((size_t)sy * w + sx) * comps;
+            std::copy(in, in + comps, out);
+        }
+    }
+
+    return dst;
+}
+
+// Pixel kernels. Each one has a portable version and, on x86, an SSE2
+// version (always present on x86-64) and an AVX2 version, chosen at run
+// time. They work on 8-bit samples; anything else takes the generic path.
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EMPDFER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(EMPDFER_SSE2) && defined(__GNUC__)
+#define EMPDFER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+void split_alpha_generic(const unsigned char* src, size_t pixels,
+                         unsigned color_channels, unsigned bytes_per_sample,
+                         unsigned char* color, unsigned char* alpha)
+{
+    const size_t color_bytes = color_channels * bytes_per_sample;
+
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        std::copy(src, src + color_bytes, color);
+        std::copy(src + color_bytes, src + color_bytes + bytes_per_sample,
+                  alpha);
+        src += color_bytes + bytes_per_sample;
+        color += color_bytes;
+        alpha += bytes_per_sample;
+    }
+}
+
+void split_rgba_scalar(const unsigned char* src, size_t pixels,
+                       unsigned char* rgb, unsigned char* alpha)
+{
+    for (size_t i = 0; i < pixels; ++i, src += 4, rgb += 3)
+    {
+        rgb[0] = src[0];
+        rgb[1] = src[1];
+        rgb[2] = src[2];
+        alpha[i] = src[3];
+    }
+}
+
+void split_ga_scalar(const unsigned char* src, size_t pixels,
+                     unsigned char* gray, unsigned char* alpha)
+{
+    for (size_t i = 0; i < pixels; ++i, src += 2)
+    {
+        gray[i] = src[0];
+        alpha[i] = src[1];
+    }
+}
+
+// c over white: 255 - (255 - c) * a / 255, rounded.
+inline unsigned char over_white(unsigned c, unsigned a)
+{
+    unsigned t = (255 - c) * a + 128;
+    return (unsigned char)(255 - ((t + (t >> 8)) >> 8));
+}
+
+void flatten_alpha_scalar(const unsigned char* src, size_t pixels,
+                          unsigned color_channels, unsigned char* color)
+{
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        unsigned a = src[color_channels];
+        for (unsigned c = 0; c < color_channels; ++c)
+            *color++ = over_white(src[c], a);
+        src += color_channels + 1;
+    }
+}
+
+bool is_gray_scalar(const unsigned char* rgb, size_t pixels,
+                    unsigned tolerance)
+{
+    for (size_t i = 0; i < pixels; ++i, rgb += 3)
+        if ((unsigned)std::abs(rgb[0] - rgb[1]) > tolerance ||
+            (unsigned)std::abs(rgb[1] - rgb[2]) > tolerance)
+            return false;
+    return true;
+}
+
+bool is_bilevel_scalar(const unsigned char* gray, size_t samples,
+                       unsigned tolerance)
+{
+    for (size_t i = 0; i < samples; ++i)
+        if (gray[i] > tolerance && gray[i] < 255 - tolerance)
+            return false;
+    return true;
+}
+
+#ifdef EMPDFER_SSE2
+// Number of pixels, from the start, found gray in blocks of sixteen. Stops
+// at the first block that is not, and leaves the rest to the scalar code.
+size_t gray_prefix_sse2(const unsigned char* rgb, size_t pixels,
+                        unsigned tolerance)
+{
+    // Each byte is compared with the next one, except for blue, followed
+    // by the red of the next pixel. Sixteen pixels take three vectors, so
+    // each vector always skips the same bytes.
+    const __m128i keep[3] = {
+        _mm_setr_epi8(-1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0,
+                      -1),
+        _mm_setr_epi8(-1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1,
+                      -1),
+        _mm_setr_epi8(0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1,
+                      0)};
+    // Any tolerance above 255 passes every byte, as in the scalar code.
+    const __m128i t = _mm_set1_epi8((char)std::min(tolerance, 255u));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    // The last vector of a block is compared with the byte after it.
+    for (; i + 17 <= pixels; i += 16)
+    {
+        const unsigned char* p = rgb + 3 * i;
+        __m128i over = zero;
+        for (int k = 0; k < 3; ++k)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(p + 16 * k));
+            __m128i b = _mm_loadu_si128((const __m128i*)(p + 16 * k + 1));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(a, b),
+                                     _mm_subs_epu8(b, a));
+            over = _mm_or_si128(over,
+                                _mm_and_si128(_mm_subs_epu8(d, t), keep[k]));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(over, zero)) != 0xffff)
+            break;
+    }
+
+    return i;
+}
+
+size_t bilevel_prefix_sse2(const unsigned char* gray, size_t samples,
+                           unsigned tolerance)
+{
+    const __m128i t = _mm_set1_epi8((char)std::min(tolerance, 255u));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(gray + i));
+        __m128i black = _mm_cmpeq_epi8(_mm_subs_epu8(v, t), zero);
+        __m128i white = _mm_cmpeq_epi8(_mm_adds_epu8(v, t), ones);
+        if (_mm_movemask_epi8(_mm_or_si128(black, white)) != 0xffff)
+            break;
+    }
+
+    return i;
+}
+
+// Drops the alpha byte of the four RGBA pixels in v and stores the twelve
+// RGB bytes at dst. Writes four bytes past them, which the caller must
+// allow.
+inline void store_rgb_sse2(__m128i v, unsigned char* dst)
+{
+    // Within each 64-bit half, keep the first pixel in place and move the
+    // second one next to it.
+    const __m128i lo = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+    const __m128i hi = _mm_set_epi32(0x0000ffff, (int)0xff000000,
+                                     0x0000ffff, (int)0xff000000);
+    __m128i r = _mm_or_si128(_mm_and_si128(v, lo),
+                             _mm_and_si128(_mm_srli_epi64(v, 8), hi));
+    _mm_storel_epi64((__m128i*)dst, r);
+    _mm_storel_epi64((__m128i*)(dst + 6), _mm_unpackhi_epi64(r, r));
+}
+
+// The alpha bytes of the sixteen RGBA pixels in v0..v3.
+inline __m128i alpha_sse2(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+    __m128i a01 = _mm_packs_epi32(_mm_srli_epi32(v0, 24),
+                                  _mm_srli_epi32(v1, 24));
+    __m128i a23 = _mm_packs_epi32(_mm_srli_epi32(v2, 24),
+                                  _mm_srli_epi32(v3, 24));
+    return _mm_packus_epi16(a01, a23);
+}
+
+size_t split_rgba_sse2(const unsigned char* src, size_t pixels,
+                       unsigned char* rgb, unsigned char* alpha)
+{
+    size_t i = 0;
+
+    // Stop while there is at least one pixel left, so that the extra bytes
+    // written by store_rgb_sse2 are still inside the destination.
+    for (; i + 16 < pixels; i += 16)
+    {
+        const __m128i* s = (const __m128i*)(src + 4 * i);
+        __m128i v0 = _mm_loadu_si128(s);
+        __m128i v1 = _mm_loadu_si128(s + 1);
+        __m128i v2 = _mm_loadu_si128(s + 2);
+        __m128i v3 = _mm_loadu_si128(s + 3);
+
+        unsigned char* d = rgb + 3 * i;
+        store_rgb_sse2(v0, d);
+        store_rgb_sse2(v1, d + 12);
+        store_rgb_sse2(v2, d + 24);
+        store_rgb_sse2(v3, d + 36);
+
+        _mm_storeu_si128((__m128i*)(alpha + i), alpha_sse2(v0, v1, v2, v3));
+    }
+
+    return i;
+}
+
+size_t split_ga_sse2(const unsigned char* src, size_t pixels,
+                     unsigned char* gray, unsigned char* alpha)
+{
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    size_t i = 0;
+
+    for (; i + 16 <= pixels; i += 16)
+    {
+        const __m128i* s = (const __m128i*)(src + 2 * i);
+        __m128i v0 = _mm_loadu_si128(s);
+        __m128i v1 = _mm_loadu_si128(s + 1);
+
+        _mm_storeu_si128((__m128i*)(gray + i),
+                         _mm_packus_epi16(_mm_and_si128(v0, low_bytes),
+                                          _mm_and_si128(v1, low_bytes)));
+        _mm_storeu_si128((__m128i*)(alpha + i),
+                         _mm_packus_epi16(_mm_srli_epi16(v0, 8),
+                                          _mm_srli_epi16(v1, 8)));
+    }
+
+    return i;
+}
+
+// over_white() on the sixteen-bit values of c and a.
+inline __m128i over_white_sse2(__m128i c, __m128i a)
+{
+    const __m128i max = _mm_set1_epi16(255);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, c), a),
+                              _mm_set1_epi16(128));
+    t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    return _mm_sub_epi16(max, t);
+}
+
+// Composites each byte of v over white using the alpha in a.
+inline __m128i over_white_sse2_bytes(__m128i v, __m128i a)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = over_white_sse2(_mm_unpacklo_epi8(v, zero),
+                                 _mm_unpacklo_epi8(a, zero));
+    __m128i hi = over_white_sse2(_mm_unpackhi_epi8(v, zero),
+                                 _mm_unpackhi_epi8(a, zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+size_t flatten_rgba_sse2(const unsigned char* src, size_t pixels,
+                         unsigned char* rgb)
+{
+    size_t i = 0;
+
+    for (; i + 4 < pixels; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+
+        // Copy the alpha of each pixel to its four bytes.
+        __m128i a = _mm_srli_epi32(v, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+        store_rgb_sse2(over_white_sse2_bytes(v, a), rgb + 3 * i);
+    }
+
+    return i;
+}
+
+size_t flatten_ga_sse2(const unsigned char* src, size_t pixels,
+                       unsigned char* gray)
+{
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    size_t i = 0;
+
+    for (; i + 16 <= pixels; i += 16)
+    {
+        const __m128i* s = (const __m128i*)(src + 2 * i);
+        __m128i v0 = _mm_loadu_si128(s);
+        __m128i v1 = _mm_loadu_si128(s + 1);
+
+        // Once widened to sixteen bits, the gray and alpha of each pixel
+        // are in separate lanes.
+        __m128i g0 = over_white_sse2(_mm_and_si128(v0, low_bytes),
+                                     _mm_srli_epi16(v0, 8));
+        __m128i g1 = over_white_sse2(_mm_and_si128(v1, low_bytes),
+                                     _mm_srli_epi16(v1, 8));
+
+        _mm_storeu_si128((__m128i*)(gray + i), _mm_packus_epi16(g0, g1));
+    }
+
+    return i;
+}
+#endif // EMPDFER_SSE2
+
+#ifdef EMPDFER_AVX2
+__attribute__((target("avx2")))
+size_t split_rgba_avx2(const unsigned char* src, size_t pixels,
+                       unsigned char* rgb, unsigned char* alpha)
+{
+    // Within each 128-bit lane, move the RGB bytes to the front and the
+    // alpha bytes to the end. Then join the RGB bytes of both lanes.
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+
+    for (; i + 8 <= pixels; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + 4 * i));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle),
+                                        permute);
+
+        __m128i lo = _mm256_castsi256_si128(v);
+        __m128i hi = _mm256_extracti128_si256(v, 1);
+        _mm_storeu_si128((__m128i*)(rgb + 3 * i), lo);
+        _mm_storel_epi64((__m128i*)(rgb + 3 * i + 16), hi);
+        _mm_storel_epi64((__m128i*)(alpha + i), _mm_unpackhi_epi64(hi, hi));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t split_ga_avx2(const unsigned char* src, size_t pixels,
+                     unsigned char* gray, unsigned char* alpha)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    size_t i = 0;
+
+    for (; i + 16 <= pixels; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, shuffle),
+                                     _MM_SHUFFLE(3, 1, 2, 0));
+
+        _mm_storeu_si128((__m128i*)(gray + i), _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(alpha + i),
+                         _mm256_extracti128_si256(v, 1));
+    }
+
+    return i;
+}
+
+bool has_avx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif // EMPDFER_AVX2
+} // namespace
+
+void empdfer::split_alpha(const unsigned char* src, size_t pixels,
+                          unsigned color_channels, unsigned bytes_per_sample,
+                          unsigned char* color, unsigned char* alpha)
+{
+    if (bytes_per_sample != 1 || (color_channels != 1 && color_channels != 3))
+    {
+        split_alpha_generic(src, pixels, color_channels, bytes_per_sample,
+                            color, alpha);
+        return;
+    }
+
+    // Number of pixels done by the vector code, the rest is done below.
+    size_t done = 0;
+
+#ifdef EMPDFER_AVX2
+    if (has_avx2())
+        done = color_channels == 3 ?
+               split_rgba_avx2(src, pixels, color, alpha) :
+               split_ga_avx2(src, pixels, color, alpha);
+    else
+#endif
+#ifdef EMPDFER_SSE2
+        done = color_channels == 3 ?
+               split_rgba_sse2(src, pixels, color, alpha) :
+               split_ga_sse2(src, pixels, color, alpha);
+#endif
+
+    const size_t channels = color_channels + 1;
+    if (color_channels == 3)
+        split_rgba_scalar(src + channels * done, pixels - done,
+                          color + color_channels * done, alpha + done);
+    else
+        split_ga_scalar(src + channels * done, pixels - done,
+                        color + done, alpha + done);
+}
+
+void empdfer::flatten_alpha(const unsigned char* src, size_t pixels,
+                            unsigned color_channels, unsigned char* color)
+{
+    size_t done = 0;
+
+#ifdef EMPDFER_SSE2
+    if (color_channels == 3)
+        done = flatten_rgba_sse2(src, pixels, color);
+    else if (color_channels == 1)
+        done = flatten_ga_sse2(src, pixels, color);
+#endif
+
+    flatten_alpha_scalar(src + (color_channels + 1) * done, pixels - done,
+                         color_channels, color + color_channels * done);
+}
+
+bool empdfer::is_gray(const unsigned char* rgb, size_t pixels,
+                      unsigned tolerance)
+{
+    size_t done = 0;
+#ifdef EMPDFER_SSE2
+    done = gray_prefix_sse2(rgb, pixels, tolerance);
+#endif
+    return is_gray_scalar(rgb + 3 * done, pixels - done, tolerance);
+}
+
+bool empdfer::is_bilevel(const unsigned char* gray, size_t samples,
+                         unsigned tolerance)
+{
+    size_t done = 0;
+#ifdef EMPDFER_SSE2
+    done = bilevel_prefix_sse2(gray, samples, tolerance);
+#endif
+    return is_bilevel_scalar(gray + done, samples - done, tolerance);
+}
+
+void empdfer::rgb_to_gray(const unsigned char* rgb, size_t pixels,
+                          unsigned char* gray)
+{
+    for (size_t i = 0; i < pixels; ++i, rgb += 3)
+        gray[i] = (rgb[0] + 2 * rgb[1] + rgb[2] + 2) / 4;
+}
+
+void empdfer::pack_bilevel(const unsigned char* gray, unsigned width,
+                           unsigned height, unsigned threshold,
+                           unsigned char* bits)
+{
+    size_t row_bytes = (width + 7) / 8;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        unsigned char* row = bits + y * row_bytes;
+        std::fill(row, row + row_bytes, 0);
+        for (unsigned x = 0; x < width; ++x, ++gray)
+            if (*gray >= threshold)
+                row[x / 8] |= 0x80 >> (x % 8);
+    }
+}
+
+bool empdfer::reduce_to_gray(Pixels& pixels, unsigned tolerance)
+{
+    StageTimer timer(STAGE_TRANSFORM);
+
+    size_t n = (size_t)pixels.width * pixels.height;
+    if (pixels.components != 3 || !is_gray(pixels.data.data(), n, tolerance))
+        return false;
+
+    std::vector<unsigned char> gray = acquire_buffer(n);
+    rgb_to_gray(pixels.data.data(), n, gray.data());
+    pixels.data.swap(gray);
+    release_buffer(std::move(gray));
+    pixels.components = 1;
+    return true;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_PIXELS_H
+#define EMPDFER_PIXELS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace empdfer {
+
+// A decoded 8-bit image, rows stored top to bottom without padding.
+struct Pixels
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned components = 0;
+    std::vector<unsigned char> data;
+};
+
+// Scales the image down to width x height pixels, averaging the area of
+// the source covered by each destination pixel. The new size must not be
+// larger than the current one.
+Pixels resample(const Pixels&, unsigned width, unsigned height);
+
+// Rotates the image counter-clockwise by the given number of quarter turns.
+Pixels rotate(const Pixels&, unsigned quarter_turns);
+
+// Splits interleaved color and alpha samples (gray and alpha, or RGB and
+// alpha) into the color samples and the alpha samples. Samples are one or
+// two bytes long. Uses SSE2 or AVX2 when the CPU has them.
+void split_alpha(const unsigned char* src, size_t pixels,
+                 unsigned color_channels, unsigned bytes_per_sample,
+                 unsigned char* color, unsigned char* alpha);
+
+// Composites interleaved 8-bit color and alpha samples over a white
+// background, and writes the resulting color samples.
+void flatten_alpha(const unsigned char* src, size_t pixels,
+                   unsigned color_channels, unsigned char* color);
+
+// Whether, in every RGB pixel, red and green, and green and blue, differ
+// by at most tolerance. Uses SSE2 when the CPU has it.
+bool is_gray(const unsigned char* rgb, size_t pixels, unsigned tolerance);
+
+// Whether every sample is within tolerance of black or white. Uses SSE2
+// when the CPU has it.
+bool is_bilevel(const unsigned char* gray, size_t samples,
+                unsigned tolerance);
+
+// Converts RGB pixels to gray, keeping the value of those already gray.
+void rgb_to_gray(const unsigned char* rgb, size_t pixels,
+                 unsigned char* gray);
+
+// Packs rows of gray samples into 1 bit per pixel, 1 for the samples of at
+// least threshold. Each row starts on a new byte.
+void pack_bilevel(const unsigned char* gray, unsigned width, unsigned height,
+                  unsigned threshold, unsigned char* bits);
+
+// Turns RGB pixels into gray if they are gray within the tolerance, as
+// is_gray() tells. Returns whether they were.
+bool reduce_to_gray(Pixels&, unsigned tolerance);
+
+} // namespace empdfer
+
+#endif // EMPDFER_PIXELS_H
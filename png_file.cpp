@@ -15,227 +15,489 @@
 // You should have received a copy of the GNU General Public License
 // along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "buffer_pool.h"
 #include "jpeg_file.h"
-#include "matrix.h"
+#include "pixels.h"
 #include "png_file.h"
+#include "stats.h"
 
 #include <png.h>
 
 #include <cmath>
 #include <cstring>
 #include <exception>
-#include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <string>
 
+namespace {
+unsigned long be32(const unsigned char* b)
+{
+    return ((unsigned long)b[0] << 24) | ((unsigned long)b[1] << 16) |
+           ((unsigned long)b[2] << 8) | (unsigned long)b[3];
+}
+
+// Lets libpng read from a stream, so that the file can be in memory.
+void read_input(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    std::istream* in = (std::istream*)png_get_io_ptr(png_ptr);
+    if (!in->read((char*)data, length))
+        png_error(png_ptr, "truncated PNG file");
+}
+
+// Reads the next count rows. libpng reports errors by jumping back to the
+// last setjmp call, which is made here so that no C++ frames are skipped.
+bool read_rows(png_structp png_ptr, unsigned char* rows, size_t row_bytes,
+               unsigned count)
+{
+    if (setjmp(png_jmpbuf(png_ptr)))
+        return false;
+
+    for (unsigned i = 0; i < count; ++i)
+        png_read_row(png_ptr, rows + i * row_bytes, NULL);
+    return true;
+}
+
+bool read_end(png_structp png_ptr)
+{
+    if (setjmp(png_jmpbuf(png_ptr)))
+        return false;
+
+    png_read_end(png_ptr, (png_infop)NULL);
+    return true;
+}
+
+// PDF Flate streams with the PNG predictors (/Predictor 15) use the same
+// format as the concatenated IDAT chunks of a PNG file. So, when the
+// colors of the file map directly to a PDF color space, the compressed
+// data can be embedded without decoding it. This is not possible for
+// palette, alpha or interlaced images.
+void png_passthrough(const empdfer::Input& input,
+                     const empdfer::ImageInfo& info,
+                     const empdfer::ImageOptions& options,
+                     empdfer::PageImage& p)
+{
+    empdfer::StageTimer timer(empdfer::STAGE_READ);
+
+    empdfer::InputStream f(input);
+    if (!f)
+        throw std::runtime_error(input.name + ": unable to open file");
+
+    empdfer::Image& image = p.image;
+    std::vector<unsigned char>& idat = image.data;
+
+    // Lengths are checked against what is left of the input, so that a
+    // corrupt one does not make the data grow beyond it.
+    uintmax_t input_bytes = empdfer::input_size(input);
+
+    // Each chunk is length, type, data and CRC.
+    f.seekg(8);
+    unsigned char chunk[8];
+    while (f.read((char*)chunk, 8))
+    {
+        unsigned long length = be32(chunk);
+        std::string type((char*)chunk + 4, 4);
+
+        if (type == "IEND")
+            break;
+
+        if (type != "IDAT")
+        {
+            f.seekg(length + 4, std::ios_base::cur);
+            continue;
+        }
+
+        std::streamoff position = f.tellg();
+        if (position < 0 || length > input_bytes - (uintmax_t)position)
+            throw std::runtime_error(input.name + ": truncated PNG file");
+
+        size_t old_size = idat.size();
+        idat.resize(old_size + length);
+        if (!f.read((char*)idat.data() + old_size, length))
+            throw std::runtime_error(input.name + ": truncated PNG file");
+        f.seekg(4, std::ios_base::cur);
+    }
+
+    if (idat.empty())
+        throw std::runtime_error(input.name + ": invalid PNG file");
+    empdfer::count(empdfer::COUNTER_BYTES_READ, idat.size());
+
+    image.width = info.width;
+    image.height = info.height;
+    image.components = info.components;
+    image.bits_per_component = info.bits_per_component;
+    image.color_space = info.color_space;
+    image.filter = empdfer::FILTER_FLATE;
+    image.predictor = 15;
+
+    empdfer::layout(p, image.width, image.height, info.x_density_dpmm,
+                    info.y_density_dpmm, options);
+}
+
+// Whether the compressed data of the file can be embedded as it is.
+bool embeds_as_is(const empdfer::ImageInfo& info,
+                  const empdfer::ImageOptions& options)
+{
+    return options.embed_flate && options.quality == -1 && !info.indexed &&
+           !info.alpha && !info.interlaced;
+}
+} // namespace
+
+empdfer::ImageInfo empdfer::probe_png(const Input& input)
+{
+    empdfer::InputStream f(input);
+    if (!f)
+        throw std::runtime_error(input.name + ": unable to open file");
+
+    unsigned char signature[8];
+    if (!f.read((char*)signature, 8) || png_sig_cmp(signature, 0, 8))
+        throw std::runtime_error(input.name + ": invalid PNG file");
+
+    ImageInfo info;
+    info.type = PNG;
+    // If the resolution cannot be determined, set it to 300dpi.
+    info.x_density_dpmm = info.y_density_dpmm = 300. / 25.4;
+    bool header = false;
+
+    // Everything needed comes before the image data. Each chunk is length,
+    // type, data and CRC.
+    unsigned char chunk[8];
+    while (f.read((char*)chunk, 8))
+    {
+        unsigned long length = be32(chunk);
+        std::string type((char*)chunk + 4, 4);
+
+        if (type == "IDAT" || type == "IEND")
+            break;
+
+        // Only the header and the resolution are read, and only if their
+        // length is right. Other chunks can be large, and are skipped.
+        unsigned char data[13];
+        bool wanted = (type == "IHDR" && length == 13) ||
+                      (type == "pHYs" && length == 9);
+        if (wanted && !f.read((char*)data, length))
+            throw std::runtime_error(input.name + ": truncated PNG file");
+        f.seekg((wanted ? 0 : length) + 4, std::ios_base::cur);
+
+        if (type == "IHDR" && length == 13)
+        {
+            unsigned color_type = data[9];
+
+            info.width = be32(data);
+            info.height = be32(data + 4);
+            info.bits_per_component = data[8];
+            info.interlaced = data[12] != PNG_INTERLACE_NONE;
+            info.indexed = color_type == PNG_COLOR_TYPE_PALETTE;
+            info.alpha = color_type & PNG_COLOR_MASK_ALPHA;
+            info.components = color_type & PNG_COLOR_MASK_COLOR ? 3 : 1;
+            info.color_space = color_type & PNG_COLOR_MASK_COLOR ?
+                               DEVICE_RGB : DEVICE_GRAY;
+            // Palettes are expanded to 8-bit samples.
+            if (info.indexed)
+                info.bits_per_component = 8;
+            header = true;
+        }
+        // libpng turns the transparency of palettes into an alpha channel.
+        else if (type == "tRNS" && info.indexed)
+            info.alpha = true;
+        // The resolution is usually specified in dots per meter, we need
+        // it in dots per millimeter.
+        else if (type == "pHYs" && length == 9 &&
+                 data[8] == PNG_RESOLUTION_METER)
+        {
+            info.x_density_dpmm = be32(data) / 1000.;
+            info.y_density_dpmm = be32(data + 4) / 1000.;
+        }
+    }
+
+    if (!header)
+        throw std::runtime_error(input.name + ": invalid PNG file");
+
+    info.file_size = empdfer::input_size(input);
+
+    return info;
+}
+
 // See http://www.libpng.org/pub/png/libpng-1.2.5-manual.html#section-3 for
 // explanation on how to use libpng.
-paddlefish::PagePtr empdfer::png_page(const std::string& input_file,
-                                      double page_x_mm, double page_y_mm,
-                                      double img_x_mm, double img_y_mm,
-                                      int quality, double rotation,
-                                      bool shrink)
+empdfer::PageImage empdfer::png_page(const Input& input,
+                                     const ImageInfo& info,
+                                     const ImageOptions& options)
 {
-    paddlefish::PagePtr p(new paddlefish::Page());
+    PageImage p;
+
+    // Images whose colors may be reduced, or made black and white, are
+    // decoded, unless they have a single bit already.
+    if (embeds_as_is(info, options) &&
+        ((options.gray_tolerance < 0 && options.threshold < 0) ||
+         info.bits_per_component == 1))
+    {
+        png_passthrough(input, info, options, p);
+        return p;
+    }
 
     unsigned x_size, y_size;
 
-    FILE *fp = fopen(input_file.c_str(), "rb");
+    empdfer::StageTimer decode_timer(empdfer::STAGE_DECODE);
+
+    InputStream in(input);
 
-    if (!fp)
-        throw std::runtime_error(input_file + ": unable to open file");
+    if (!in)
+        throw std::runtime_error(input.name + ": unable to open file");
 
     // Read the header of the file.
     unsigned char header[8];
     png_size_t number_to_check = 8;
-    if (fread(header, 1, 8, fp) != (unsigned long)ftell(fp))
-        throw std::runtime_error(input_file + ": could not read PNG header");
+    if (!in.read((char*)header, number_to_check))
+        throw std::runtime_error(input.name + ": could not read PNG header");
 
     // Check the file is valid.
     if(png_sig_cmp(header, 0, number_to_check))
-        throw std::runtime_error(input_file + ": invalid PNG file");
+        throw std::runtime_error(input.name + ": invalid PNG file");
 
     // Initialize.
     png_structp png_ptr =
         png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
     if (!png_ptr)
-        throw std::runtime_error(input_file + ": cannot init PNG structure");
+        throw std::runtime_error(input.name + ": cannot init PNG structure");
 
     png_infop info_ptr = png_create_info_struct(png_ptr);
 
     if (!info_ptr){
         png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
-        throw std::runtime_error(input_file + ": cannot init PNG info struct");
+        throw std::runtime_error(input.name + ": cannot init PNG info struct");
     }
 
+    // libpng reports errors by jumping back to the setjmp call, skipping
+    // the destructors of whatever was created after it. So, the buffers
+    // are declared before.
+    std::vector<unsigned char> image;
+    std::vector<unsigned char> mask;
+    std::vector<png_bytep> row_pointers;
+
     if (setjmp(png_jmpbuf(png_ptr)))
-        throw std::runtime_error(input_file + ": cannot set jump to struct");
+    {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        empdfer::release_buffer(std::move(image));
+        throw std::runtime_error(input.name + ": cannot decode PNG file");
+    }
 
     // Read file header and the information we need.
 
-    png_init_io(png_ptr, fp);
+    png_set_read_fn(png_ptr, &in, read_input);
     png_set_sig_bytes(png_ptr, number_to_check);
     png_read_info(png_ptr, info_ptr);
 
     x_size = png_get_image_width(png_ptr, info_ptr);
     y_size = png_get_image_height(png_ptr, info_ptr);
-    png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-    png_byte channels = png_get_channels(png_ptr, info_ptr);
 
-    // Get color type, and convert palette to RGB if needed.
-    png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-    if (color_type == PNG_COLOR_TYPE_PALETTE)
-    {
+    // Convert palette to RGB if needed. libpng also turns the palette
+    // transparency, if any, into an alpha channel.
+    if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_PALETTE)
         png_set_palette_to_rgb(png_ptr);
-        color_type = PNG_COLOR_TYPE_RGB;
-        channels = 3;
-        bit_depth = 8;
+
+    // JPEG only takes 8-bit samples, one per byte, and thresholds are for
+    // 8-bit samples too.
+    bool lossless = options.quality == -1 && options.threshold < 0;
+    if (!lossless)
+    {
+        png_set_strip_16(png_ptr);
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
     }
 
-    // Get the PNG resolution.
-    unsigned res_x, res_y;
-    int unit_type;
-    png_get_pHYs(png_ptr, info_ptr, &res_x, &res_y, &unit_type);
+    // Interlaced images are read whole, all the passes at once.
+    png_set_interlace_handling(png_ptr);
+
+    // Get the format of the rows, once transformed.
+    png_read_update_info(png_ptr, info_ptr);
+    png_byte color_type = png_get_color_type(png_ptr, info_ptr);
+    png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+    png_byte channels = png_get_channels(png_ptr, info_ptr);
+    size_t row_bytes = png_get_rowbytes(png_ptr, info_ptr);
 
     // Done reading data from the header.
 
-    // The resolution is usually specified in dots per meter, we need it
-    // in dots per millimeter.
-    double x_density_dpmm, y_density_dpmm;
-    switch (unit_type)
+    empdfer::layout(p, x_size, y_size, info.x_density_dpmm,
+                    info.y_density_dpmm, options);
+
+    // Rows go from libpng to libjpeg a strip at a time, so that the whole
+    // image is never in memory. Interlaced images come in several passes
+    // over all the rows, and they are read whole, like those to embed
+    // losslessly or whose colors may be reduced. The rows must hold one
+    // byte per sample, as the encoder reads them.
+    if (options.quality != -1 && !options.defer_jpeg && !info.interlaced &&
+        options.gray_tolerance < 0 && options.threshold < 0 &&
+        row_bytes == (size_t)x_size * channels)
     {
-        case PNG_RESOLUTION_METER:
-            x_density_dpmm = res_x / 1000.;
-            y_density_dpmm = res_y / 1000.;
-            break;
-        default:
-            // If the resolution cannot be determined, set it to 300dpi.
-            x_density_dpmm = y_density_dpmm = 300. / 25.4;
-            break;
-    }
+        decode_timer.stop();
 
-    // Compute the image size based on the resolution in the PNG.
-    if (img_x_mm == -1. && img_y_mm == -1.)
-    {
-        img_x_mm = x_size / x_density_dpmm;
-        img_y_mm = y_size / y_density_dpmm;
-    }
+        bool alpha = color_type & PNG_COLOR_MASK_ALPHA;
+        unsigned color_channels = alpha ? channels - 1 : channels;
 
-    // Compute the missing dimensions to maintain aspect ratio in case one size
-    // was not specified.
-    else if (img_x_mm == -1.)
-        img_x_mm = (double)x_size * img_y_mm / y_size;
-    else
-        img_y_mm = (double)y_size * img_x_mm / x_size;
+        // Rows with alpha are read apart and flattened into the strip.
+        auto rows = [&](unsigned char* strip, unsigned count)
+        {
+            empdfer::StageTimer read_timer(empdfer::STAGE_DECODE);
+            if (alpha)
+                image.resize(row_bytes * count);
+            if (!read_rows(png_ptr, alpha ? image.data() : strip, row_bytes,
+                           count))
+                throw std::runtime_error(input.name +
+                                         ": cannot decode PNG file");
+            read_timer.stop();
+
+            if (alpha)
+            {
+                empdfer::StageTimer timer(empdfer::STAGE_ALPHA);
+                empdfer::flatten_alpha(image.data(), (size_t)x_size * count,
+                                       color_channels, strip);
+            }
+        };
+
+        Image& img = p.image;
+        try
+        {
+            img.data = empdfer::create_jpeg(rows, x_size, y_size,
+                    color_channels, color_channels == 1 ? JCS_GRAYSCALE :
+                    JCS_RGB, options.quality);
+            if (!read_end(png_ptr))
+                throw std::runtime_error(input.name +
+                                         ": cannot decode PNG file");
+        }
+        catch (...)
+        {
+            png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+            throw;
+        }
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
 
-    // Compute the PDF transformation matrix for the image.
-    double matrix23[6];
-    empdfer::fill_matrix(matrix23, img_x_mm, img_y_mm, page_x_mm, page_y_mm,
-                         rotation, shrink);
+        empdfer::count(empdfer::COUNTER_BYTES_READ, in.tellg());
+        empdfer::count(empdfer::COUNTER_PIXELS, (uint64_t)x_size * y_size);
 
-    unsigned char *image = (unsigned char*)png_malloc(
-        png_ptr, y_size * x_size * bit_depth * channels * sizeof(png_bytep));
-    unsigned char *mask = NULL;
+        img.width = x_size;
+        img.height = y_size;
+        img.components = color_channels;
+        img.color_space = color_channels == 1 ? DEVICE_GRAY : DEVICE_RGB;
+        img.filter = FILTER_DCT;
+        return p;
+    }
 
-    png_bytep* row_pointers = (png_bytep*)malloc(y_size * sizeof(png_bytep));
+    image = empdfer::acquire_buffer(row_bytes * y_size);
+    row_pointers.resize(y_size);
 
     for (unsigned i = 0; i < y_size; ++i)
-        row_pointers[i] =
-            image + i * x_size * channels * bit_depth / sizeof(png_bytep);
+        row_pointers[i] = image.data() + i * row_bytes;
+
+    png_read_image(png_ptr, row_pointers.data());
+    png_read_end(png_ptr, (png_infop)NULL);
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
 
-    png_read_image(png_ptr, row_pointers);
+    empdfer::count(empdfer::COUNTER_BYTES_READ, in.tellg());
+    empdfer::count(empdfer::COUNTER_PIXELS, (uint64_t)x_size * y_size);
+    decode_timer.stop();
 
-    // If the image has transparency, separate the actual colors from the mask.
+    // If the image has transparency, separate the actual colors from the
+    // mask. JPEG has no transparency, so when converting to it, or to
+    // black and white, blend the colors over a white background instead.
     if (color_type & PNG_COLOR_MASK_ALPHA)
     {
-        std::cerr << "handling aplha" << std::endl;
-        unsigned color_channels = channels - 1;
+        empdfer::StageTimer timer(empdfer::STAGE_ALPHA);
 
-        unsigned char *plain = (unsigned char*)malloc(
-                y_size * x_size * bit_depth * color_channels * sizeof(png_bytep));
+        unsigned color_channels = channels - 1;
+        unsigned bytes_per_sample = bit_depth / 8;
+        size_t pixels = (size_t)x_size * y_size;
 
-        mask = (unsigned char*)malloc(
-                y_size * x_size * bit_depth * sizeof(unsigned char));
+        std::vector<unsigned char> plain = empdfer::acquire_buffer(
+                pixels * color_channels * bytes_per_sample);
 
-        for (unsigned row = 0; row < y_size; ++row)
-            for (unsigned col = 0; col < x_size; ++col)
-            {
-                    unsigned offset = row * x_size + col;
-                    for (unsigned comp = 0; comp < color_channels; ++comp)
-                        plain[color_channels * offset + comp] =
-                            image[channels * offset + comp];
-                    mask[offset] = image[channels * offset + 3];
-            }
+        if (lossless)
+        {
+            mask = empdfer::acquire_buffer(pixels * bytes_per_sample);
+            empdfer::split_alpha(image.data(), pixels, color_channels,
+                                 bytes_per_sample, plain.data(), mask.data());
+        }
+        else
+            empdfer::flatten_alpha(image.data(), pixels, color_channels,
+                                   plain.data());
 
         // Swap contents of plain and image.
-        unsigned char *temp = image;
-        image = plain;
-        plain = temp;
+        image.swap(plain);
+        empdfer::release_buffer(std::move(plain));
 
-        // TODO: do this only if quality==-1, then fix embedding in the page.
         color_type -= PNG_COLOR_MASK_ALPHA;
         channels = color_channels;
     }
 
-    //png_read_end(NULL, NULL);
-    //png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+    Image& img = p.image;
+    img.width = x_size;
+    img.height = y_size;
+    img.components = channels;
+    img.bits_per_component = bit_depth;
+    img.color_space = (color_type == PNG_COLOR_TYPE_GRAY ||
+                       color_type == PNG_COLOR_TYPE_GRAY_ALPHA) ?
+                      DEVICE_GRAY : DEVICE_RGB;
 
-    fclose(fp);
+    if (lossless)
+    {
+        img.data.swap(image);
 
-    // Set the page size.
-    p->set_mediabox(0, 0, MILIMETERS(page_x_mm), MILIMETERS(page_y_mm));
+        if (!mask.empty())
+        {
+            img.mask = std::make_shared<Image>();
+            img.mask->width = x_size;
+            img.mask->height = y_size;
+            img.mask->components = 1;
+            img.mask->bits_per_component = bit_depth;
+            img.mask->color_space = DEVICE_GRAY;
+            img.mask->data.swap(mask);
+        }
 
-    if (quality == -1)
-    {
-        p->add_image_bytes(image,
-                mask,
-                bit_depth,
-                channels,
-                x_size,
-                y_size,
-                matrix23,
-                (color_type == PNG_COLOR_TYPE_GRAY ||
-                 color_type == PNG_COLOR_TYPE_GRAY_ALPHA) ?
-                COLORSPACE_DEVICEGRAY : COLORSPACE_DEVICERGB,
-                true);
+        // Images that could not be reduced are better off with the
+        // compressed data of the file, filtered by the PNG predictors.
+        if (options.gray_tolerance >= 0 &&
+            !empdfer::reduce_colors(img, options.gray_tolerance) &&
+            embeds_as_is(info, options))
+        {
+            empdfer::release_buffer(std::move(img.data));
+            p = PageImage();
+            png_passthrough(input, info, options, p);
+        }
     }
     else
     {
-        // If the user wants to compress, we need first to combine the background
-        // and the image using the alpha channel, if there is one.
-        if (color_type & PNG_COLOR_MASK_ALPHA)
-        {
-            std::cerr << "alpha channel\n";
-            /*
-               {
-            // TODO: combine the alpha with the RGB or gray bytes.
-            std::cout << "removing alpha" << std::endl;
+        Pixels pixels;
+        pixels.width = x_size;
+        pixels.height = y_size;
+        pixels.components = channels;
+        pixels.data.swap(image);
 
-            if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
-            {
-            std::cout << "valid" << std::endl;
-            png_set_tRNS_to_alpha(png_ptr);
-            }
-
-            png_set_strip_alpha(png_ptr);
-            color_type -= PNG_COLOR_MASK_ALPHA;
-            channels = color_type == PNG_COLOR_TYPE_RGB ? 3 : 1;
-            }*/
+        if (options.threshold >= 0)
+        {
+            empdfer::threshold_image(img, pixels, options.threshold);
+            empdfer::release_buffer(std::move(pixels.data));
+            return p;
         }
 
-        std::string compressed_file =
-            std::filesystem::temp_directory_path().string() + "/" + input_file +
-            "_compressed_" + std::to_string(quality);
-
-        empdfer::create_jpeg(compressed_file, image, x_size, y_size, channels,
-                channels == 1 ? JCS_GRAYSCALE : JCS_RGB, quality);
-
-        p->add_jpeg_image(compressed_file, x_size, y_size,
-                matrix23,
-                channels == 1 ? COLORSPACE_DEVICEGRAY :
-                COLORSPACE_DEVICERGB);
+        bool reduce = options.gray_tolerance >= 0;
+        if (reduce)
+            empdfer::reduce_to_gray(pixels, options.gray_tolerance);
+
+        img.filter = FILTER_DCT;
+        img.components = pixels.components;
+        img.bits_per_component = 8;
+        img.color_space = pixels.components == 1 ? DEVICE_GRAY : DEVICE_RGB;
+        if (reduce && pixels.components == 1 &&
+            empdfer::bilevel_image(img, pixels.data.data(),
+                                   options.gray_tolerance))
+            empdfer::release_buffer(std::move(pixels.data));
+        else if (options.defer_jpeg)
+            img.pixels = std::make_shared<Pixels>(std::move(pixels));
+        else
+        {
+            img.data = empdfer::create_jpeg(pixels, options.quality,
+                                            options.pool);
+            empdfer::release_buffer(std::move(pixels.data));
+        }
     }
 
     return p;
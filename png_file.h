@@ -20,12 +20,14 @@
 
 #include <string>
 
-#include <paddlefish/paddlefish.h>
+#include "image.h"
 
 namespace empdfer {
 
-paddlefish::PagePtr png_page(const std::string&, double, double, double,
-                             double, int, double, bool);
+// Reads the chunks of the input that come before the image data.
+ImageInfo probe_png(const Input&);
+
+PageImage png_page(const Input&, const ImageInfo&, const ImageOptions&);
 } // namespace empdfer
 
 #endif // EMPDFER_PNG_FILE_H
@@ -0,0 +1,256 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "job.h"
+#include "json.h"
+#include "libempdfer.h"
+#include "serve.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#ifndef EMPDFER_WINDOWS
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::string answer(const empdfer::JsonValue& id, const std::string& members)
+{
+    return "{\"id\": " + empdfer::json_text(id) + ", " + members + "}\n";
+}
+
+std::string run_job(const std::string& line,
+                    const empdfer::ImageOptions& defaults,
+                    empdfer::ThreadPool* pool)
+{
+    empdfer::JsonValue id;
+    try
+    {
+        empdfer::JsonValue request = empdfer::parse_json(line);
+        if (const empdfer::JsonValue* v = request.find("id"))
+            id = *v;
+
+        empdfer::Job job = empdfer::parse_job(request, defaults);
+
+        std::ofstream f;
+        if (!job.output.empty())
+        {
+            f.open(job.output, std::ios_base::out|std::ios_base::binary);
+            if (!f)
+                throw std::runtime_error(job.output +
+                                         ": can't open output file");
+        }
+
+        std::string pdf;
+        size_t bytes = 0;
+        empdfer::Document d([&](const char* data, size_t size)
+                            {
+                                if (f.is_open())
+                                    f.write(data, size);
+                                else
+                                    pdf.append(data, size);
+                                bytes += size;
+                            }, pool);
+        size_t pages = job.pages.size();
+        empdfer::add_pages(job, d);
+        d.finish();
+
+        if (f.is_open())
+        {
+            f.close();
+            if (!f)
+                throw std::runtime_error(job.output +
+                                         ": can't write output file");
+        }
+
+        std::string members = "\"ok\": true, \"pages\": " +
+                              std::to_string(pages) + ", \"bytes\": " +
+                              std::to_string(bytes);
+        if (job.output.empty())
+            members += ", \"pdf\": \"" +
+                       empdfer::base64_encode((const unsigned char*)pdf.data(),
+                                              pdf.size()) + "\"";
+        return answer(id, members);
+    }
+    catch (const std::exception& e)
+    {
+        return answer(id, "\"ok\": false, \"error\": " +
+                          empdfer::json_string(e.what()));
+    }
+}
+
+#ifndef EMPDFER_WINDOWS
+// Reads and writes a socket through a stream.
+class SocketStreamBuf : public std::streambuf
+{
+public:
+    explicit SocketStreamBuf(int fd) :
+        fd_(fd), in_(64 * 1024), out_(64 * 1024)
+    {
+        setg(in_.data(), in_.data(), in_.data());
+        setp(out_.data(), out_.data() + out_.size());
+    }
+
+    ~SocketStreamBuf() override
+    {
+        sync();
+        close(fd_);
+    }
+
+protected:
+    int_type underflow() override
+    {
+        ssize_t n;
+        do
+            n = recv(fd_, in_.data(), in_.size(), 0);
+        while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return traits_type::eof();
+
+        setg(in_.data(), in_.data(), in_.data() + n);
+        return traits_type::to_int_type(in_[0]);
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (sync() != 0)
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        // A client that went away must not kill the server with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        const char* p = pbase();
+        while (p < pptr())
+        {
+            ssize_t n = send(fd_, p, pptr() - p, flags);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                setp(out_.data(), out_.data() + out_.size());
+                return -1;
+            }
+            p += n;
+        }
+        setp(out_.data(), out_.data() + out_.size());
+        return 0;
+    }
+
+private:
+    int fd_;
+    std::vector<char> in_;
+    std::vector<char> out_;
+};
+#endif // EMPDFER_WINDOWS
+} // namespace
+
+void empdfer::serve(std::istream& in, std::ostream& out,
+                    const ImageOptions& defaults, ThreadPool* pool)
+{
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        out << run_job(line, defaults, pool);
+        out.flush();
+        if (!out)
+            break;
+    }
+}
+
+void empdfer::serve_socket(const std::string& path,
+                           const ImageOptions& defaults, ThreadPool* pool)
+{
+#ifdef EMPDFER_WINDOWS
+    throw std::runtime_error("serving on a socket is not supported on "
+                             "Windows");
+#else
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error(path + ": socket path too long");
+    strcpy(address.sun_path, path.c_str());
+
+    // A socket left by a previous run would make bind() fail, so it goes.
+    // Anything else at the path stays, it is most likely a mistake.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+            throw std::runtime_error(path + ": not a socket");
+        unlink(path.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(path + ": can't create socket");
+
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0)
+    {
+        std::string error = strerror(errno);
+        close(fd);
+        throw std::runtime_error(path + ": " + error);
+    }
+
+    while (true)
+    {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::string error = strerror(errno);
+            close(fd);
+            throw std::runtime_error(path + ": " + error);
+        }
+
+        // Connections wait on each other only for the workers of the pool.
+        std::thread([client, defaults, pool]()
+                    {
+                        SocketStreamBuf buffer(client);
+                        std::istream in(&buffer);
+                        std::ostream out(&buffer);
+                        serve(in, out, defaults, pool);
+                    }).detach();
+    }
+#endif // EMPDFER_WINDOWS
+}
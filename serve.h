@@ -0,0 +1,51 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_SERVE_H
+#define EMPDFER_SERVE_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "image.h"
+#include "thread_pool.h"
+
+namespace empdfer {
+
+// A long-running process builds documents as they are requested, without
+// paying for starting up each time. Each request is a job (see job.h) on
+// a line of its own. Each answer is a line with a JSON object:
+//
+//     {"id": 1, "ok": true, "pages": 2, "bytes": 12345,
+//      "pdf": "<base64 bytes of the document>"}
+//     {"id": 2, "ok": false, "error": "a.jpg: can't open input file"}
+//
+// There is no "pdf" member when the job names an output file.
+
+// Answers the jobs read from in, in order, until it ends.
+void serve(std::istream& in, std::ostream& out, const ImageOptions& defaults,
+           ThreadPool* pool);
+
+// Listens on a Unix domain socket and serves each connection as above, all
+// of them at the same time. Only returns by throwing std::runtime_error.
+void serve_socket(const std::string& path, const ImageOptions& defaults,
+                  ThreadPool* pool);
+
+} // namespace empdfer
+
+#endif // EMPDFER_SERVE_H
@@ -0,0 +1,56 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_SHA256_H
+#define EMPDFER_SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "input.h"
+
+namespace empdfer {
+
+// SHA-256 (FIPS 180-4), used to identify image contents.
+class Sha256
+{
+public:
+    Sha256();
+
+    void update(const void*, size_t);
+    void update(const std::string& s) { update(s.data(), s.size()); }
+
+    // Returns the digest as 64 hexadecimal digits. The object cannot be
+    // updated afterwards.
+    std::string hex_digest();
+
+private:
+    void block(const unsigned char*);
+
+    uint32_t state_[8];
+    unsigned char buffer_[64];
+    size_t buffered_;
+    uint64_t length_;
+};
+
+// Hash of the bytes of an input.
+std::string sha256_input(const Input&);
+
+} // namespace empdfer
+
+#endif // EMPDFER_SHA256_H
@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "json.h"
+#include "stats.h"
+
+namespace {
+thread_local empdfer::Stats* current_stats = NULL;
+
+const char* const stage_names[empdfer::STAGE_COUNT] = {
+    "probe", "read", "decode", "transform", "alpha", "encode", "transcode",
+    "deflate", "hash", "cache", "write"
+};
+
+const char* const counter_names[empdfer::COUNTER_COUNT] = {
+    "bytes_read", "bytes_written", "pixels", "temp_files"
+};
+
+void write_json(std::ostream& out, const empdfer::Stats& stats)
+{
+    out << "\"seconds\": {";
+    for (unsigned i = 0; i < empdfer::STAGE_COUNT; ++i)
+        out << (i ? ", " : "") << "\"" << stage_names[i] << "\": " <<
+            stats.seconds[i];
+    out << "}";
+
+    for (unsigned i = 0; i < empdfer::COUNTER_COUNT; ++i)
+        out << ", \"" << counter_names[i] << "\": " << stats.counters[i];
+}
+} // namespace
+
+void empdfer::Stats::add(const Stats& other)
+{
+    for (unsigned i = 0; i < STAGE_COUNT; ++i)
+        seconds[i] += other.seconds[i];
+    for (unsigned i = 0; i < COUNTER_COUNT; ++i)
+        counters[i] += other.counters[i];
+}
+
+empdfer::StatsScope::StatsScope(Stats* stats) : previous_(current_stats)
+{
+    current_stats = stats;
+}
+
+empdfer::StatsScope::~StatsScope()
+{
+    current_stats = previous_;
+}
+
+empdfer::Stats* empdfer::active_stats()
+{
+    return current_stats;
+}
+
+empdfer::StageTimer::StageTimer(Stage stage) :
+    stats_(current_stats), stage_(stage)
+{
+    if (stats_)
+        start_ = std::chrono::steady_clock::now();
+}
+
+empdfer::StageTimer::~StageTimer()
+{
+    stop();
+}
+
+void empdfer::StageTimer::stop()
+{
+    if (stats_)
+        stats_->seconds[stage_] += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_).count();
+    stats_ = NULL;
+}
+
+void empdfer::count(Counter counter, uint64_t n)
+{
+    if (current_stats)
+        current_stats->counters[counter] += n;
+}
+
+empdfer::CountingStreamBuf::int_type
+empdfer::CountingStreamBuf::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+
+    int_type result = sink_->sputc(traits_type::to_char_type(c));
+    if (!traits_type::eq_int_type(result, traits_type::eof()))
+        count(COUNTER_BYTES_WRITTEN, 1);
+    return result;
+}
+
+std::streamsize empdfer::CountingStreamBuf::xsputn(const char* s,
+                                                   std::streamsize n)
+{
+    std::streamsize written = sink_->sputn(s, n);
+    count(COUNTER_BYTES_WRITTEN, written);
+    return written;
+}
+
+int empdfer::CountingStreamBuf::sync()
+{
+    return sink_->pubsync();
+}
+
+void empdfer::write_stats_json(std::ostream& out,
+                               const std::vector<std::string>& inputs,
+                               const std::vector<Stats>& pages,
+                               const Stats& document, double wall_seconds)
+{
+    Stats total = document;
+
+    out << "{\"pages\": [";
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        out << (i ? ",\n  " : "\n  ") << "{\"input\": " <<
+            empdfer::json_string(inputs[i]) << ", ";
+        write_json(out, pages[i]);
+        out << "}";
+        total.add(pages[i]);
+    }
+
+    out << "],\n \"document\": {";
+    write_json(out, document);
+    out << "},\n \"total\": {\"pages\": " << pages.size() <<
+        ", \"wall_seconds\": " << wall_seconds << ", ";
+    write_json(out, total);
+    out << "}}\n";
+}
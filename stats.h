@@ -0,0 +1,130 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_STATS_H
+#define EMPDFER_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace empdfer {
+
+// Timers and counters for each stage of the work on a page. A thread
+// records into the Stats object given to the StatsScope it is in, if any;
+// otherwise, timers and counters cost a check of a thread-local pointer.
+
+enum Stage
+{
+    STAGE_PROBE,
+    STAGE_READ,
+    STAGE_DECODE,
+    STAGE_TRANSFORM,
+    STAGE_ALPHA,
+    STAGE_ENCODE,
+    STAGE_TRANSCODE,
+    STAGE_DEFLATE,
+    STAGE_HASH,
+    STAGE_CACHE,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+
+enum Counter
+{
+    COUNTER_BYTES_READ,
+    COUNTER_BYTES_WRITTEN,
+    COUNTER_PIXELS,
+    COUNTER_TEMP_FILES,
+    COUNTER_COUNT
+};
+
+struct Stats
+{
+    double seconds[STAGE_COUNT] = {};
+    uint64_t counters[COUNTER_COUNT] = {};
+
+    void add(const Stats&);
+};
+
+class StatsScope
+{
+public:
+    // Records into stats, which may be NULL, until destroyed.
+    explicit StatsScope(Stats* stats);
+    ~StatsScope();
+
+    StatsScope(const StatsScope&) = delete;
+    StatsScope& operator=(const StatsScope&) = delete;
+
+private:
+    Stats* previous_;
+};
+
+// The stats the calling thread records into, or NULL. Lets work handed to
+// other threads be recorded with the rest.
+Stats* active_stats();
+
+// Adds the time it lives to the stage. Timed stages must not nest.
+class StageTimer
+{
+public:
+    explicit StageTimer(Stage);
+    ~StageTimer();
+
+    // Ends the time added before the timer is destroyed.
+    void stop();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stats* stats_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+void count(Counter, uint64_t);
+
+// Counts the bytes going through it into COUNTER_BYTES_WRITTEN, and passes
+// them on to another buffer.
+class CountingStreamBuf : public std::streambuf
+{
+public:
+    explicit CountingStreamBuf(std::streambuf* sink) : sink_(sink) {}
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    std::streambuf* sink_;
+};
+
+// Writes the stats of each page, of the work not related to any page, and
+// their totals.
+void write_stats_json(std::ostream&, const std::vector<std::string>& inputs,
+                      const std::vector<Stats>& pages,
+                      const Stats& document, double wall_seconds);
+
+} // namespace empdfer
+
+#endif // EMPDFER_STATS_H
@@ -0,0 +1,137 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "target_size.h"
+#include "buffer_pool.h"
+#include "jpeg_file.h"
+
+#include <algorithm>
+
+namespace {
+// What each page and the document structure take at most, besides the
+// images, as written by PdfWriter.
+const uintmax_t page_bytes = 600;
+const uintmax_t document_bytes = 300;
+
+uintmax_t image_bytes(const empdfer::Image& image)
+{
+    uintmax_t bytes = image.source.empty() ?
+        image.data.size() : empdfer::input_size(image.source);
+    if (image.mask)
+        bytes += image_bytes(*image.mask);
+    return bytes;
+}
+
+// Qualities to try next, between lo and hi. The first round tries hi,
+// where the search ends if the images fit already.
+std::vector<int> candidates(int lo, int hi, unsigned count, bool first)
+{
+    std::vector<int> c;
+    for (unsigned j = 1; j <= count; ++j)
+    {
+        int q = first ? lo + (hi - lo) * j / count :
+                        lo + (hi - lo) * j / (count + 1);
+        if (c.empty() || q > c.back())
+            c.push_back(q);
+    }
+    return c;
+}
+} // namespace
+
+int empdfer::fit_quality(std::vector<PageImage>& pages, uintmax_t budget,
+                         int max_quality, ThreadPool* pool, uintmax_t& bytes)
+{
+    // Images already encoded take the same space whatever the quality.
+    std::vector<Image*> deferred;
+    uintmax_t fixed = document_bytes;
+    for (PageImage& p : pages)
+    {
+        fixed += page_bytes + image_bytes(p.image);
+        if (p.image.pixels)
+            deferred.push_back(&p.image);
+    }
+
+    // Encoded data of the best quality found to fit so far.
+    int best = -1;
+    uintmax_t best_bytes = 0;
+    std::vector<std::vector<unsigned char>> best_data;
+
+    size_t m = deferred.size();
+    unsigned count = 1;
+    if (pool && m > 0)
+        count = std::clamp<unsigned>(pool->size() / m, 1, 4);
+
+    int lo = 1, hi = std::clamp(max_quality, 1, 100);
+    for (bool first = true; m > 0 && lo <= hi; first = false)
+    {
+        std::vector<int> c = candidates(lo, hi, count, first);
+        std::vector<std::vector<std::vector<unsigned char>>> data(c.size());
+        std::vector<uintmax_t> total(c.size(), fixed);
+
+        size_t t = 0;
+        ordered_for_each(pool, m * c.size(), m * c.size(),
+            [&](size_t i)
+            {
+                return create_jpeg(*deferred[i % m]->pixels, c[i / m],
+                                   pool);
+            },
+            [&](std::vector<unsigned char>&& encoded)
+            {
+                total[t / m] += encoded.size();
+                data[t / m].push_back(std::move(encoded));
+                ++t;
+            });
+
+        // Qualities from the first one that does not fit up are too high,
+        // and those up to the last one that fits need no more trying.
+        int fail = hi + 1;
+        for (size_t j = 0; j < c.size(); ++j)
+        {
+            if (total[j] <= budget)
+            {
+                best = c[j];
+                best_bytes = total[j];
+                best_data.swap(data[j]);
+                lo = c[j] + 1;
+            }
+            else
+            {
+                fail = c[j];
+                break;
+            }
+        }
+        hi = fail - 1;
+
+        // Nothing fits, settle for the smallest images.
+        if (hi < 1 && best == -1)
+        {
+            best = c[0];
+            best_bytes = total[0];
+            best_data.swap(data[0]);
+        }
+    }
+
+    for (size_t i = 0; i < m; ++i)
+    {
+        deferred[i]->data.swap(best_data[i]);
+        empdfer::release_buffer(std::move(deferred[i]->pixels->data));
+        deferred[i]->pixels.reset();
+    }
+
+    bytes = m > 0 ? best_bytes : fixed;
+    return best;
+}
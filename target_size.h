@@ -0,0 +1,41 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_TARGET_SIZE_H
+#define EMPDFER_TARGET_SIZE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+#include "thread_pool.h"
+
+namespace empdfer {
+
+// Encodes the JPEG images of the pages that kept their pixels (see
+// ImageOptions::defer_jpeg) with the highest quality, up to max_quality,
+// that makes a document of the pages fit in budget bytes, or with quality
+// 1 if nothing does. Candidate qualities are encoded on the pool, several
+// at the same time when there are fewer images than workers, and the
+// search stops as soon as the best one that fits is known. Returns the
+// quality chosen, and sets bytes to the expected size of the document.
+int fit_quality(std::vector<PageImage>& pages, uintmax_t budget,
+                int max_quality, ThreadPool* pool, uintmax_t& bytes);
+
+} // namespace empdfer
+
+#endif // EMPDFER_TARGET_SIZE_H
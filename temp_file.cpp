@@ -0,0 +1,97 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stats.h"
+#include "temp_file.h"
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <random>
+
+namespace {
+std::mutex temp_files_mutex;
+std::vector<std::filesystem::path> temp_files;
+} // namespace
+
+const std::string& empdfer::process_tag()
+{
+    static const std::string tag = []()
+    {
+        std::random_device rd;
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+        return std::string(buf);
+    }();
+    return tag;
+}
+
+std::string empdfer::temp_file(const std::vector<unsigned char>& bytes,
+                               const std::string& hint)
+{
+    return temp_file(Input(hint, bytes.data(), bytes.size()), hint);
+}
+
+std::string empdfer::temp_file(const Input& bytes, const std::string& hint)
+{
+    static std::atomic<unsigned long> counter(0);
+
+    std::string name = std::filesystem::path(hint).filename().string();
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+    // The "x" mode fails if the file exists, so a name is never reused.
+    FILE* f = NULL;
+    std::filesystem::path path;
+    for (int attempt = 0; f == NULL && attempt < 16; ++attempt)
+    {
+        path = dir / ("empdfer_" + process_tag() + "_" +
+                      std::to_string(counter++) + "_" + name);
+        f = fopen(path.string().c_str(), "wbx");
+    }
+
+    if (f == NULL)
+        throw std::runtime_error(path.string() + ": can't create temp file");
+
+    size_t written = fwrite(bytes.data, 1, bytes.size, f);
+    fclose(f);
+
+    count(COUNTER_TEMP_FILES, 1);
+    count(COUNTER_BYTES_WRITTEN, written);
+
+    {
+        std::lock_guard<std::mutex> lock(temp_files_mutex);
+        temp_files.push_back(path);
+    }
+
+    if (written != bytes.size)
+        throw std::runtime_error(path.string() + ": can't write temp file");
+
+    return path.string();
+}
+
+void empdfer::remove_temp_files()
+{
+    std::lock_guard<std::mutex> lock(temp_files_mutex);
+
+    std::error_code ec;
+    for (const auto& path : temp_files)
+        std::filesystem::remove(path, ec);
+
+    temp_files.clear();
+}
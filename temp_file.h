@@ -0,0 +1,47 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_TEMP_FILE_H
+#define EMPDFER_TEMP_FILE_H
+
+#include <string>
+#include <vector>
+
+#include "input.h"
+
+namespace empdfer {
+
+// Writes the bytes to a new, uniquely named file in the temporary directory
+// and returns its path. The name is derived from the file name of the
+// second argument, only to make the file recognizable. The file is removed
+// by remove_temp_files().
+std::string temp_file(const std::vector<unsigned char>&, const std::string&);
+
+// Same, with the bytes of an input in memory.
+std::string temp_file(const Input&, const std::string&);
+
+// A random tag, the same during the whole run. Files named after it do not
+// clash with those of other processes sharing a directory.
+const std::string& process_tag();
+
+// Removes all the files created by temp_file(). Call it once the document
+// was written.
+void remove_temp_files();
+
+} // namespace empdfer
+
+#endif // EMPDFER_TEMP_FILE_H
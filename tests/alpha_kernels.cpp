@@ -0,0 +1,132 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checks split_alpha() and flatten_alpha(), whichever of their vector
+// versions the CPU runs, against plain loops, for pixel counts around the
+// block sizes of the vector code so that the scalar tails are run too.
+
+#include "pixels.h"
+
+#include <iostream>
+#include <vector>
+
+namespace {
+// Bytes after the outputs that must be left alone.
+const size_t guard = 64;
+const unsigned char guard_value = 0xa5;
+
+std::vector<unsigned char> samples(size_t size, unsigned seed)
+{
+    std::vector<unsigned char> data(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 24;
+    }
+    // Fully transparent and fully opaque alpha, and the color extremes.
+    if (size > 0)
+        data[0] = 0;
+    if (size > 1)
+        data[size - 1] = 255;
+    return data;
+}
+
+bool guarded(const std::vector<unsigned char>& out, size_t size)
+{
+    for (size_t i = size; i < out.size(); ++i)
+        if (out[i] != guard_value)
+            return false;
+    return true;
+}
+
+bool check_split(size_t pixels, unsigned color_channels,
+                 unsigned bytes_per_sample)
+{
+    const size_t sample_bytes = bytes_per_sample;
+    const size_t color_bytes = color_channels * sample_bytes;
+    std::vector<unsigned char> src =
+        samples(pixels * (color_bytes + sample_bytes), pixels + 1);
+
+    std::vector<unsigned char> color(pixels * color_bytes + guard,
+                                     guard_value);
+    std::vector<unsigned char> alpha(pixels * sample_bytes + guard,
+                                     guard_value);
+    empdfer::split_alpha(src.data(), pixels, color_channels,
+                         bytes_per_sample, color.data(), alpha.data());
+
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        const unsigned char* p = &src[i * (color_bytes + sample_bytes)];
+        for (size_t b = 0; b < color_bytes; ++b)
+            if (color[i * color_bytes + b] != p[b])
+                return false;
+        for (size_t b = 0; b < sample_bytes; ++b)
+            if (alpha[i * sample_bytes + b] != p[color_bytes + b])
+                return false;
+    }
+    return guarded(color, pixels * color_bytes) &&
+        guarded(alpha, pixels * sample_bytes);
+}
+
+bool check_flatten(size_t pixels, unsigned color_channels)
+{
+    std::vector<unsigned char> src =
+        samples(pixels * (color_channels + 1), pixels + 7);
+
+    std::vector<unsigned char> color(pixels * color_channels + guard,
+                                     guard_value);
+    empdfer::flatten_alpha(src.data(), pixels, color_channels, color.data());
+
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        const unsigned char* p = &src[i * (color_channels + 1)];
+        unsigned a = p[color_channels];
+        // c over white, rounded to the nearest.
+        for (unsigned c = 0; c < color_channels; ++c)
+            if (color[i * color_channels + c] !=
+                255 - ((255 - p[c]) * a + 127) / 255)
+                return false;
+    }
+    return guarded(color, pixels * color_channels);
+}
+} // namespace
+
+int main()
+{
+    const size_t counts[] = {0, 1, 2, 7, 8, 9, 15, 16, 17, 31, 32, 33,
+                             63, 64, 65, 1000, 1003};
+    int failed = 0;
+    for (size_t pixels : counts)
+        for (unsigned color_channels : {1, 3})
+        {
+            for (unsigned bytes_per_sample : {1, 2})
+                if (!check_split(pixels, color_channels, bytes_per_sample))
+                {
+                    std::cerr << pixels << " pixels of " << color_channels <<
+                        " colors and alpha, " << 8 * bytes_per_sample <<
+                        "-bit: wrong split" << std::endl;
+                    ++failed;
+                }
+            if (!check_flatten(pixels, color_channels))
+            {
+                std::cerr << pixels << " pixels of " << color_channels <<
+                    " colors and alpha: wrong flattening" << std::endl;
+                ++failed;
+            }
+        }
+    return failed;
+}
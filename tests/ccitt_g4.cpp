@@ -0,0 +1,396 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checks the CCITT Group 4 encoder against data encoded by libtiff, and
+// decodes what it writes for other images with a plain T.6 decoder, which
+// must give the images back.
+
+#include "ccitt.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// Codes of T.4, written out as bits. Terminating codes are indexed by the
+// run, make-up codes by the run / 64 - 1, extended ones by
+// (run - 1792) / 64.
+const char* const white_terminating[64] = {
+    "00110101", "000111", "0111", "1000", "1011", "1100", "1110", "1111",
+    "10011", "10100", "00111", "01000", "001000", "000011", "110100",
+    "110101", "101010", "101011", "0100111", "0001100", "0001000",
+    "0010111", "0000011", "0000100", "0101000", "0101011", "0010011",
+    "0100100", "0011000", "00000010", "00000011", "00011010", "00011011",
+    "00010010", "00010011", "00010100", "00010101", "00010110", "00010111",
+    "00101000", "00101001", "00101010", "00101011", "00101100", "00101101",
+    "00000100", "00000101", "00001010", "00001011", "01010010", "01010011",
+    "01010100", "01010101", "00100100", "00100101", "01011000", "01011001",
+    "01011010", "01011011", "01001010", "01001011", "00110010", "00110011",
+    "00110100"};
+
+const char* const white_makeup[27] = {
+    "11011", "10010", "010111", "0110111", "00110110", "00110111",
+    "01100100", "01100101", "01101000", "01100111", "011001100",
+    "011001101", "011010010", "011010011", "011010100", "011010101",
+    "011010110", "011010111", "011011000", "011011001", "011011010",
+    "011011011", "010011000", "010011001", "010011010", "011000",
+    "010011011"};
+
+const char* const black_terminating[64] = {
+    "0000110111", "010", "11", "10", "011", "0011", "0010", "00011",
+    "000101", "000100", "0000100", "0000101", "0000111", "00000100",
+    "00000111", "000011000", "0000010111", "0000011000", "0000001000",
+    "00001100111", "00001101000", "00001101100", "00000110111",
+    "00000101000", "00000010111", "00000011000", "000011001010",
+    "000011001011", "000011001100", "000011001101", "000001101000",
+    "000001101001", "000001101010", "000001101011", "000011010010",
+    "000011010011", "000011010100", "000011010101", "000011010110",
+    "000011010111", "000001101100", "000001101101", "000011011010",
+    "000011011011", "000001010100", "000001010101", "000001010110",
+    "000001010111", "000001100100", "000001100101", "000001010010",
+    "000001010011", "000000100100", "000000110111", "000000111000",
+    "000000100111", "000000101000", "000001011000", "000001011001",
+    "000000101011", "000000101100", "000001011010", "000001100110",
+    "000001100111"};
+
+const char* const black_makeup[27] = {
+    "0000001111", "000011001000", "000011001001", "000001011011",
+    "000000110011", "000000110100", "000000110101", "0000001101100",
+    "0000001101101", "0000001001010", "0000001001011", "0000001001100",
+    "0000001001101", "0000001110010", "0000001110011", "0000001110100",
+    "0000001110101", "0000001110110", "0000001110111", "0000001010010",
+    "0000001010011", "0000001010100", "0000001010101", "0000001011010",
+    "0000001011011", "0000001100100", "0000001100101"};
+
+const char* const extended_makeup[13] = {
+    "00000001000", "00000001100", "00000001101", "000000010010",
+    "000000010011", "000000010100", "000000010101", "000000010110",
+    "000000010111", "000000011100", "000000011101", "000000011110",
+    "000000011111"};
+
+class BitReader
+{
+public:
+    explicit BitReader(const std::vector<unsigned char>& data) :
+        data_(data), pos_(0) {}
+
+    // Whether the next bits are the code, which they are consumed if so.
+    bool next_is(const char* code)
+    {
+        size_t n = strlen(code);
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t bit = pos_ + i;
+            if (bit / 8 >= data_.size())
+                return false;
+            if (((data_[bit / 8] >> (7 - bit % 8)) & 1) != (code[i] == '1'))
+                return false;
+        }
+        pos_ += n;
+        return true;
+    }
+
+private:
+    const std::vector<unsigned char>& data_;
+    size_t pos_;
+};
+
+unsigned read_run(BitReader& r, bool black)
+{
+    const char* const* terminating =
+        black ? black_terminating : white_terminating;
+    const char* const* makeup = black ? black_makeup : white_makeup;
+    unsigned run = 0;
+
+    while (true)
+    {
+        bool found = false;
+        for (unsigned k = 0; k < 13 && !found; ++k)
+            if (r.next_is(extended_makeup[k]))
+            {
+                run += 1792 + 64 * k;
+                found = true;
+            }
+        for (unsigned k = 0; k < 27 && !found; ++k)
+            if (r.next_is(makeup[k]))
+            {
+                run += 64 * (k + 1);
+                found = true;
+            }
+        if (found)
+            continue;
+        for (unsigned k = 0; k < 64; ++k)
+            if (r.next_is(terminating[k]))
+                return run + k;
+        throw std::runtime_error("bad run code");
+    }
+}
+
+// Decodes T.6 data into rows packed like the input of encode_g4(), and
+// checks that it ends with an EOFB.
+std::vector<unsigned char> decode_g4(const std::vector<unsigned char>& data,
+                                     unsigned width, unsigned height)
+{
+    const char* const vertical[7] = {
+        "0000010", "000010", "010", "1", "011", "000011", "0000011"};
+    size_t row_bytes = (width + 7) / 8;
+    std::vector<unsigned char> bits(row_bytes * height, 0xff);
+    BitReader r(data);
+
+    // Changing elements: the positions where the color changes, the
+    // even ones from white to black.
+    std::vector<long> reference;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        std::vector<long> coding;
+        long a0 = -1;
+        bool black = false;
+        while (a0 < (long)width)
+        {
+            size_t j = 0;
+            while (j < reference.size() &&
+                   (reference[j] <= a0 || (j % 2 == 1) != black))
+                ++j;
+            long b1 = j < reference.size() ? reference[j] : width;
+            long b2 = j + 1 < reference.size() ? reference[j + 1] : width;
+
+            if (r.next_is("0001"))
+                a0 = b2;
+            else if (r.next_is("001"))
+            {
+                long a1 = std::max(a0, 0L) + read_run(r, black);
+                long a2 = a1 + read_run(r, !black);
+                coding.push_back(a1);
+                coding.push_back(a2);
+                a0 = a2;
+            }
+            else
+            {
+                int d = 0;
+                while (d < 7 && !r.next_is(vertical[d]))
+                    ++d;
+                if (d == 7)
+                    throw std::runtime_error("bad mode code");
+                a0 = b1 + d - 3;
+                coding.push_back(a0);
+                black = !black;
+            }
+            if (a0 > (long)width)
+                throw std::runtime_error("row too long");
+        }
+
+        // Runs of no pixels give the same position twice, and the end of
+        // the row is not a change.
+        reference.clear();
+        for (long c : coding)
+            if (!reference.empty() && reference.back() == c)
+                reference.pop_back();
+            else if (c < (long)width)
+                reference.push_back(c);
+
+        unsigned char* row = bits.data() + y * row_bytes;
+        for (size_t k = 0; k < reference.size(); k += 2)
+        {
+            long end = k + 1 < reference.size() ? reference[k + 1] : width;
+            for (long x = reference[k]; x < end; ++x)
+                row[x / 8] &= ~(0x80 >> (x % 8));
+        }
+    }
+
+    if (!r.next_is("000000000001") || !r.next_is("000000000001"))
+        throw std::runtime_error("no EOFB");
+    return bits;
+}
+
+// Packs an image given as runs for each row, alternating white and black
+// and starting with white.
+std::vector<unsigned char> from_runs(
+    unsigned width, const std::vector<std::vector<unsigned>>& rows)
+{
+    size_t row_bytes = (width + 7) / 8;
+    std::vector<unsigned char> bits(row_bytes * rows.size(), 0xff);
+    for (size_t y = 0; y < rows.size(); ++y)
+    {
+        unsigned x = 0;
+        bool black = false;
+        for (unsigned run : rows[y])
+        {
+            for (unsigned k = 0; k < run; ++k, ++x)
+                if (black)
+                    bits[y * row_bytes + x / 8] &= ~(0x80 >> (x % 8));
+            black = !black;
+        }
+        if (x != width)
+            throw std::logic_error("runs do not add up to the width");
+    }
+    return bits;
+}
+
+std::vector<unsigned char> from_hex(const std::string& hex)
+{
+    std::vector<unsigned char> out;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        out.push_back(std::stoi(hex.substr(i, 2), NULL, 16));
+    return out;
+}
+
+struct Vector
+{
+    const char* name;
+    unsigned width;
+    std::vector<std::vector<unsigned>> rows;
+    // As written by libtiff for the same image.
+    const char* g4;
+};
+
+const Vector vectors[] = {
+    {"all white row", 8, {{8}}, "80080080"},
+    {"all black row", 8, {{0, 8}}, "26a280080080"},
+    {"long black run", 3000, {{0, 2600, 400}}, "26a03e0d90010010"},
+    {"odd width", 13,
+     {{3, 4, 6}, {2, 6, 5}, {0, 13}, {13}, {5, 1, 1, 1, 5}, {4, 1, 3, 1, 4}},
+     "30e9c22086a430dce223aa4cab001001"},
+    {"runs past 5120", 6001, {{100, 5200, 701}, {0, 6001}, {6001}},
+     "3b1501f01f03c1793501f01f026832901f01f692906e002002"},
+};
+
+// Pseudo-random runs, from single pixels to a few thousand, with rows
+// often close to the one above so that all the modes are used.
+std::vector<unsigned char> random_image(unsigned width, unsigned height,
+                                        unsigned seed)
+{
+    unsigned state = seed * 2654435761u + 1;
+    auto next = [&state]()
+    {
+        state = state * 1103515245u + 12345u;
+        return state >> 8;
+    };
+
+    std::vector<std::vector<unsigned>> rows;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        std::vector<unsigned> runs;
+        if (y > 0 && next() % 3)
+        {
+            // The row above with its changes moved by a few pixels.
+            runs = rows.back();
+            for (size_t k = 0; k + 1 < runs.size(); ++k)
+            {
+                int d = (int)(next() % 7) - 3;
+                if ((int)runs[k] + d >= 0 && (int)runs[k + 1] - d >= 0)
+                {
+                    runs[k] += d;
+                    runs[k + 1] -= d;
+                }
+            }
+        }
+        else
+        {
+            unsigned left = width;
+            while (left > 0)
+            {
+                unsigned scale = next() % 4 == 0 ? 4000 : next() % 2 ? 70 : 8;
+                unsigned run = std::min(left, next() % scale);
+                runs.push_back(run);
+                left -= run;
+            }
+        }
+        rows.push_back(runs);
+    }
+    return from_runs(width, rows);
+}
+
+std::string hex(const std::vector<unsigned char>& data)
+{
+    std::string out;
+    char digits[3];
+    for (unsigned char c : data)
+    {
+        snprintf(digits, sizeof(digits), "%02x", c);
+        out += digits;
+    }
+    return out;
+}
+
+// Whether the padding bits past the width of each row are ignored.
+bool same_pixels(const std::vector<unsigned char>& a,
+                 const std::vector<unsigned char>& b, unsigned width,
+                 unsigned height)
+{
+    size_t row_bytes = (width + 7) / 8;
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+        {
+            size_t i = y * row_bytes + x / 8;
+            unsigned char mask = 0x80 >> (x % 8);
+            if ((a[i] & mask) != (b[i] & mask))
+                return false;
+        }
+    return true;
+}
+} // namespace
+
+int main()
+{
+    int failed = 0;
+
+    for (const Vector& v : vectors)
+    {
+        std::vector<unsigned char> bits = from_runs(v.width, v.rows);
+        std::vector<unsigned char> g4 =
+            empdfer::encode_g4(bits.data(), v.width, v.rows.size());
+        if (g4 != from_hex(v.g4))
+        {
+            std::cerr << v.name << ": got " << hex(g4) << ", expected " <<
+                v.g4 << std::endl;
+            ++failed;
+        }
+    }
+
+    const unsigned widths[] = {1, 7, 8, 13, 64, 65, 1001, 2561, 6001};
+    for (unsigned width : widths)
+        for (unsigned seed = 0; seed < 8; ++seed)
+        {
+            unsigned height = 1 + seed * 5;
+            std::vector<unsigned char> bits =
+                random_image(width, height, seed + width);
+            std::vector<unsigned char> g4 =
+                empdfer::encode_g4(bits.data(), width, height);
+            bool ok = false;
+            try
+            {
+                ok = same_pixels(decode_g4(g4, width, height), bits, width,
+                                 height);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            if (!ok)
+            {
+                std::cerr << width << "x" << height << " image " << seed <<
+                    ": does not decode to itself" << std::endl;
+                ++failed;
+            }
+        }
+
+    return failed;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Compresses images large enough to be deflated in several chunks, with
+// and without a pool, and checks zlib inflates them back to the same
+// bytes.
+
+#include "image.h"
+#include "thread_pool.h"
+
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include <zlib.h>
+
+namespace {
+// The size of the chunks deflate_image() compresses on their own.
+const size_t deflate_chunk = 256 * 1024;
+
+// Runs repeated with a period that does not divide the chunk size, so
+// that matches cross from one chunk to the next, and some noise.
+std::vector<unsigned char> samples(size_t size)
+{
+    std::vector<unsigned char> data(size);
+    unsigned seed = 12345;
+    for (size_t i = 0; i < size; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (seed >> 16) % 8 == 0 ? (unsigned char)(seed >> 24) :
+                                          (unsigned char)(i % 1000 / 7);
+    }
+    return data;
+}
+
+std::vector<unsigned char> deflated(const std::vector<unsigned char>& data,
+                                    int level, empdfer::ThreadPool* pool)
+{
+    empdfer::Image image;
+    image.width = data.size();
+    image.height = 1;
+    image.components = 1;
+    image.color_space = empdfer::DEVICE_GRAY;
+    image.data = data;
+
+    empdfer::ImageOptions options;
+    options.compression = level;
+    options.pool = pool;
+    empdfer::deflate_image(image, options);
+    if (image.filter != empdfer::FILTER_FLATE)
+        return std::vector<unsigned char>();
+    return image.data;
+}
+
+bool check(size_t size, int level, empdfer::ThreadPool* pool)
+{
+    std::vector<unsigned char> data = samples(size);
+    std::vector<unsigned char> compressed = deflated(data, level, pool);
+    if (compressed.empty())
+        return false;
+
+    // The output does not depend on the workers.
+    if (pool && compressed != deflated(data, level, NULL))
+        return false;
+
+    std::vector<unsigned char> inflated(size + 1);
+    uLongf length = inflated.size();
+    if (uncompress(inflated.data(), &length, compressed.data(),
+                   compressed.size()) != Z_OK)
+        return false;
+    inflated.resize(length);
+    return inflated == data;
+}
+} // namespace
+
+int main()
+{
+    empdfer::ThreadPool pool(3);
+    int failed = 0;
+    for (size_t size : {deflate_chunk + 1, 3 * deflate_chunk + 12345})
+        for (int level : {-1, 0, 1, 9})
+            for (empdfer::ThreadPool* p : {(empdfer::ThreadPool*)NULL, &pool})
+            {
+                bool ok = false;
+                try
+                {
+                    ok = check(size, level, p);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << e.what() << std::endl;
+                }
+                if (!ok)
+                {
+                    std::cerr << size << " bytes at level " << level <<
+                        (p ? " on a pool" : "") <<
+                        ": wrong deflated data" << std::endl;
+                    ++failed;
+                }
+            }
+    return failed;
+}
@@ -0,0 +1,183 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Builds documents from JPEG and PNG bytes in memory into a sink, and
+// checks that the sink gets a whole PDF document of all the pages, with
+// the JPEG bytes embedded as they are.
+
+#include "jpeg_file.h"
+#include "libempdfer.h"
+#include "thread_pool.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef EMPDFER_USE_PNG
+#include <png.h>
+#endif
+
+namespace {
+const unsigned width = 48, height = 32;
+
+std::vector<unsigned char> rgb_samples()
+{
+    std::vector<unsigned char> rgb(width * height * 3);
+    for (size_t i = 0; i < rgb.size(); ++i)
+        rgb[i] = (unsigned char)(i * 7 % 251);
+    return rgb;
+}
+
+std::vector<unsigned char> jpeg()
+{
+    std::vector<unsigned char> rgb = rgb_samples();
+    return empdfer::create_jpeg(rgb.data(), width, height, 3, JCS_RGB, 75);
+}
+
+#ifdef EMPDFER_USE_PNG
+void append(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto out = (std::vector<unsigned char>*)png_get_io_ptr(png_ptr);
+    out->insert(out->end(), data, data + length);
+}
+
+std::vector<unsigned char> png()
+{
+    std::vector<unsigned char> out;
+    png_structp png_ptr =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    png_set_write_fn(png_ptr, &out, append, NULL);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    std::vector<unsigned char> rgb = rgb_samples();
+    for (unsigned y = 0; y < height; ++y)
+        png_write_row(png_ptr, rgb.data() + y * width * 3);
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return out;
+}
+#endif
+
+// Whether the bytes are a PDF document of the given pages, with the cross
+// reference table where the trailer says it is.
+bool whole_pdf(const std::string& pdf, unsigned pages)
+{
+    const std::string eof = "%%EOF\n";
+    size_t startxref = pdf.rfind("startxref\n");
+    if (pdf.compare(0, 5, "%PDF-") != 0 || pdf.size() < eof.size() ||
+        pdf.compare(pdf.size() - eof.size(), eof.size(), eof) != 0 ||
+        startxref == std::string::npos)
+        return false;
+    size_t xref = strtoul(pdf.c_str() + startxref + 10, NULL, 10);
+    return pdf.compare(xref, 5, "xref\n") == 0 &&
+        pdf.find("/Count " + std::to_string(pages) + " ") !=
+        std::string::npos;
+}
+
+bool check(empdfer::ThreadPool* pool)
+{
+    std::string pdf;
+    size_t calls = 0;
+    empdfer::Document d([&](const char* data, size_t size)
+                        {
+                            pdf.append(data, size);
+                            ++calls;
+                        }, pool);
+
+    // One page from bytes the document keeps, and one from bytes it does
+    // not, which must live until finish() returns.
+    std::vector<unsigned char> a = jpeg();
+    std::string a_bytes(a.begin(), a.end());
+    d.add_page(std::move(a));
+    unsigned pages = 1;
+
+#ifdef EMPDFER_USE_PNG
+    std::vector<unsigned char> b = png();
+    empdfer::ImageOptions options;
+    options.compression = 9;
+    d.add_page(empdfer::Input("image.png", b.data(), b.size()), options);
+    ++pages;
+#endif
+
+    if (calls != 0)
+        return false;
+    d.finish();
+
+    return calls > 0 && whole_pdf(pdf, pages) &&
+        pdf.find(a_bytes) != std::string::npos &&
+        pdf.find("/DCTDecode") != std::string::npos &&
+        (pages == 1 || pdf.find("/FlateDecode") != std::string::npos);
+}
+
+// Whether finish() throws for bytes that are no image.
+bool rejects_garbage()
+{
+    std::string pdf;
+    empdfer::Document d([&](const char* data, size_t size)
+                        {
+                            pdf.append(data, size);
+                        });
+    d.add_page(std::vector<unsigned char>(100, 'x'));
+    try
+    {
+        d.finish();
+    }
+    catch (const std::exception&)
+    {
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+int main()
+{
+    empdfer::ThreadPool pool(3);
+    int failed = 0;
+    for (empdfer::ThreadPool* p : {(empdfer::ThreadPool*)NULL, &pool})
+    {
+        bool ok = false;
+        try
+        {
+            ok = check(p);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        if (!ok)
+        {
+            std::cerr << "document from memory" << (p ? " on a pool" : "") <<
+                ": wrong PDF" << std::endl;
+            ++failed;
+        }
+    }
+
+    if (!rejects_garbage())
+    {
+        std::cerr << "document from bytes that are no image: no error" <<
+            std::endl;
+        ++failed;
+    }
+    return failed;
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checks is_gray() and is_bilevel(), whichever of their vector versions
+// the CPU runs, against plain loops, on images that are just within the
+// tolerance and on images with a single value just out of it, at the
+// start, in the middle or at the last pixel.
+
+#include "pixels.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+bool is_gray(const std::vector<unsigned char>& rgb, unsigned tolerance)
+{
+    for (size_t i = 0; i < rgb.size(); i += 3)
+        if ((unsigned)std::abs(rgb[i] - rgb[i + 1]) > tolerance ||
+            (unsigned)std::abs(rgb[i + 1] - rgb[i + 2]) > tolerance)
+            return false;
+    return true;
+}
+
+bool is_bilevel(const std::vector<unsigned char>& gray, unsigned tolerance)
+{
+    for (unsigned char v : gray)
+        if (v > tolerance && v + tolerance < 255)
+            return false;
+    return true;
+}
+
+// Base plus step, clamped to 0 to 255.
+unsigned char offset(unsigned base, int step)
+{
+    int v = (int)base + step;
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// RGB pixels whose channels differ by up to tolerance.
+std::vector<unsigned char> gray_pixels(size_t pixels, unsigned tolerance,
+                                       unsigned seed)
+{
+    std::vector<unsigned char> rgb(3 * pixels);
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned g = seed >> 24;
+        int d = tolerance > 255 ? 255 : tolerance;
+        // Alternate the sign so both red and blue end up above and below
+        // green.
+        if (i % 2)
+            d = -d;
+        rgb[3 * i] = offset(g, d);
+        rgb[3 * i + 1] = g;
+        rgb[3 * i + 2] = offset(g, -d);
+    }
+    return rgb;
+}
+
+// Samples within tolerance of black or white.
+std::vector<unsigned char> bilevel_samples(size_t samples, unsigned tolerance,
+                                           unsigned seed)
+{
+    std::vector<unsigned char> gray(samples);
+    unsigned t = tolerance > 255 ? 255 : tolerance;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        gray[i] = (seed >> 24) % 2 ? t : 255 - t;
+    }
+    return gray;
+}
+
+// Positions at which to put a value out of tolerance: the first, one in
+// the middle and the last.
+std::vector<size_t> positions(size_t count)
+{
+    if (count == 0)
+        return std::vector<size_t>();
+    return {0, count / 2, count - 1};
+}
+
+// Whether the vector code, the plain loop and what the image was made to
+// be agree.
+bool agree(bool actual, bool reference, bool expected)
+{
+    return actual == reference && reference == expected;
+}
+
+int check(size_t pixels, unsigned tolerance)
+{
+    int failed = 0;
+
+    // The image within the tolerance, and then with a pixel of black and
+    // one channel one more than the tolerance away.
+    std::vector<unsigned char> rgb = gray_pixels(pixels, tolerance, pixels);
+    std::vector<std::vector<unsigned char>> rgbs(1, rgb);
+    for (size_t at : positions(pixels))
+        for (unsigned channel : {0, 1, 2})
+        {
+            std::vector<unsigned char> out = rgb;
+            unsigned char* p = &out[3 * at];
+            p[0] = p[1] = p[2] = 0;
+            p[channel] = offset(0, tolerance + 1);
+            rgbs.push_back(out);
+        }
+    for (size_t i = 0; i < rgbs.size(); ++i)
+        if (!agree(empdfer::is_gray(rgbs[i].data(), pixels, tolerance),
+                   is_gray(rgbs[i], tolerance), i == 0 || tolerance >= 255))
+        {
+            std::cerr << pixels << " RGB pixels, tolerance " << tolerance <<
+                ": wrong gray check" << std::endl;
+            ++failed;
+        }
+
+    // The same with a sample just out of the tolerance of black, or of
+    // white, which is within that of the other for large tolerances.
+    std::vector<unsigned char> gray =
+        bilevel_samples(pixels, tolerance, pixels + 1);
+    std::vector<std::vector<unsigned char>> grays(1, gray);
+    for (size_t at : positions(pixels))
+        for (int side : {0, 1})
+        {
+            std::vector<unsigned char> out = gray;
+            out[at] = side ? offset(255, -(int)tolerance - 1) :
+                             offset(0, tolerance + 1);
+            grays.push_back(out);
+        }
+    for (size_t i = 0; i < grays.size(); ++i)
+        if (!agree(empdfer::is_bilevel(grays[i].data(), pixels, tolerance),
+                   is_bilevel(grays[i], tolerance),
+                   i == 0 || 2 * tolerance + 1 >= 255))
+        {
+            std::cerr << pixels << " gray samples, tolerance " << tolerance <<
+                ": wrong bilevel check" << std::endl;
+            ++failed;
+        }
+
+    return failed;
+}
+} // namespace
+
+int main()
+{
+    const size_t counts[] = {0, 1, 2, 15, 16, 17, 31, 32, 33, 47, 48, 49,
+                             63, 64, 65, 1000, 1003};
+    int failed = 0;
+    for (size_t pixels : counts)
+        for (unsigned tolerance : {0, 1, 8, 126, 127, 128, 254, 255, 256})
+            failed += check(pixels, tolerance);
+    return failed;
+}
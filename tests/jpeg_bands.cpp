@@ -0,0 +1,148 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Encodes images tall enough to be split in bands, on a pool, and checks
+// that they decode to the same pixels as a single libjpeg encode with a
+// restart marker at the start of every band.
+
+#include "jpeg_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include <jpeglib.h>
+
+namespace {
+// MCU rows in each band, as create_jpeg() splits them.
+const long band_mcu_rows = 16;
+
+std::vector<unsigned char> samples(unsigned width, unsigned height,
+                                   unsigned components)
+{
+    std::vector<unsigned char> data((size_t)width * height * components);
+    size_t i = 0;
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+            for (unsigned c = 0; c < components; ++c)
+                data[i++] = (unsigned char)(128. +
+                    70. * std::sin(x * 0.05 + c) * std::cos(y * 0.03) +
+                    (x * 7 + y * 13 + c) % 17);
+    return data;
+}
+
+// A plain libjpeg encode, with the default settings create_jpeg() uses and
+// a restart marker every band.
+std::vector<unsigned char> single_pass(const std::vector<unsigned char>& data,
+                                       unsigned width, unsigned height,
+                                       unsigned components, int quality)
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr err;
+    cinfo.err = jpeg_std_error(&err);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char* buffer = NULL;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = components;
+    cinfo.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    int max_h = 1;
+    for (int c = 0; c < cinfo.num_components; ++c)
+        max_h = std::max(max_h, cinfo.comp_info[c].h_samp_factor);
+    long mcus_per_row = (width + DCTSIZE * max_h - 1) / (DCTSIZE * max_h);
+    cinfo.restart_interval = band_mcu_rows * mcus_per_row;
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        JSAMPROW row = const_cast<unsigned char*>(data.data()) +
+                       (size_t)cinfo.next_scanline * width * components;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    std::vector<unsigned char> out(buffer, buffer + size);
+    free(buffer);
+    return out;
+}
+
+empdfer::Pixels decode(const std::vector<unsigned char>& jpeg)
+{
+    empdfer::Input input("test.jpg");
+    input.data = jpeg.data();
+    input.size = jpeg.size();
+    return empdfer::decode_jpeg(input);
+}
+
+bool check(unsigned components, empdfer::ThreadPool* pool)
+{
+    // An odd width, and a last band of a few rows that is not a whole MCU.
+    const unsigned width = 333;
+    const unsigned mcu_height = components == 1 ? 8 : 16;
+    const unsigned height = 3 * band_mcu_rows * mcu_height + 11;
+    const int quality = 85;
+
+    std::vector<unsigned char> data = samples(width, height, components);
+    std::vector<unsigned char> banded = empdfer::create_jpeg(
+        data.data(), width, height, components,
+        components == 1 ? JCS_GRAYSCALE : JCS_RGB, quality, pool);
+
+    empdfer::Pixels actual = decode(banded);
+    empdfer::Pixels expected =
+        decode(single_pass(data, width, height, components, quality));
+    return actual.width == width && actual.height == height &&
+        actual.components == components && actual.data == expected.data;
+}
+} // namespace
+
+int main()
+{
+    empdfer::ThreadPool pool(3);
+    int failed = 0;
+    for (unsigned components : {1, 3})
+        for (empdfer::ThreadPool* p : {(empdfer::ThreadPool*)NULL, &pool})
+        {
+            bool ok = false;
+            try
+            {
+                ok = check(components, p);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            if (!ok)
+            {
+                std::cerr << components << "-component JPEG in bands" <<
+                    (p ? " on a pool" : "") << ": wrong pixels" << std::endl;
+                ++failed;
+            }
+        }
+    return failed;
+}
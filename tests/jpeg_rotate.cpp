@@ -0,0 +1,111 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Rotates JPEG images by quarter turns without decoding them, and checks
+// that the pixels match those of the decoded source rotated as pixels.
+
+#include "jpeg_file.h"
+#include "pixels.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+namespace {
+// Detail that differs along x and y, so that a block decoded with the
+// quantization steps of the wrong direction shows.
+std::vector<unsigned char> samples(unsigned width, unsigned height,
+                                   unsigned components)
+{
+    std::vector<unsigned char> data((size_t)width * height * components);
+    size_t i = 0;
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+            for (unsigned c = 0; c < components; ++c)
+                data[i++] = (unsigned char)(128. +
+                    60. * std::sin(x * 0.9 + c) +
+                    40. * std::cos(y * 0.2 + x * 0.05 * c));
+    return data;
+}
+
+empdfer::Pixels decode(const std::vector<unsigned char>& jpeg)
+{
+    empdfer::Input input("test.jpg");
+    input.data = jpeg.data();
+    input.size = jpeg.size();
+    return empdfer::decode_jpeg(input);
+}
+
+// Whether rotating the encoded image gives the pixels of the decoded one
+// rotated.
+bool check(unsigned components, unsigned quarter_turns)
+{
+    // Whole MCUs, so that every block can move.
+    const unsigned width = 128, height = 64;
+    std::vector<unsigned char> data = samples(width, height, components);
+    std::vector<unsigned char> jpeg = empdfer::create_jpeg(
+        data.data(), width, height, components,
+        components == 1 ? JCS_GRAYSCALE : JCS_RGB, 75);
+
+    empdfer::Input input("test.jpg");
+    input.data = jpeg.data();
+    input.size = jpeg.size();
+    std::vector<unsigned char> rotated;
+    if (!empdfer::transcode_jpeg(input, quarter_turns, -1, rotated))
+        return false;
+
+    empdfer::Pixels expected = empdfer::rotate(decode(jpeg), quarter_turns);
+    empdfer::Pixels actual = decode(rotated);
+    if (actual.width != expected.width || actual.height != expected.height ||
+        actual.components != expected.components)
+        return false;
+
+    // The inverse DCT rounds a little differently on transposed blocks.
+    double error = 0.;
+    for (size_t i = 0; i < actual.data.size(); ++i)
+        error += std::abs((int)actual.data[i] - (int)expected.data[i]);
+    return error / actual.data.size() < 0.5;
+}
+} // namespace
+
+int main()
+{
+    int failed = 0;
+    for (unsigned components : {1, 3})
+        for (unsigned quarter_turns : {1, 2, 3})
+        {
+            bool ok = false;
+            try
+            {
+                ok = check(components, quarter_turns);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            if (!ok)
+            {
+                std::cerr << components << "-component JPEG rotated by " <<
+                    quarter_turns * 90 << " degrees: wrong pixels" <<
+                    std::endl;
+                ++failed;
+            }
+        }
+    return failed;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checks that the JSON parser rejects what is not valid, that base64 data
+// survives a round trip, and that serve() answers each job of a stream,
+// whether it builds a document or fails.
+
+#include "jpeg_file.h"
+#include "json.h"
+#include "serve.h"
+
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+bool parses(const std::string& text)
+{
+    try
+    {
+        empdfer::parse_json(text);
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+std::string nested(unsigned depth)
+{
+    return std::string(depth, '[') + std::string(depth, ']');
+}
+
+int check_parser()
+{
+    const char* const invalid[] = {
+        "", "{", "[1, 2", "{\"a\": ", "{\"a\" 1}", "\"abc", "\"abc\\",
+        "[1,]", "tru", "1 2", "1e999", "-1e999",
+        // Escapes of other than four hexadecimal digits.
+        "\"\\u12\"", "\"\\u+123\"", "\"\\u 123\"", "\"\\u0x12\"",
+        "\"\\u-001\"", "\"\\u12g4\"",
+        // Surrogates out of a pair.
+        "\"\\ud800\"", "\"\\ud800x\"", "\"\\ud800\\u0041\"",
+        "\"\\ud800\\ud800\"", "\"\\udc00\""};
+    int failed = 0;
+    for (const char* text : invalid)
+        if (parses(text))
+        {
+            std::cerr << text << ": parsed as JSON" << std::endl;
+            ++failed;
+        }
+
+    if (!parses(nested(64)) || parses(nested(65)))
+    {
+        std::cerr << "wrong nesting limit" << std::endl;
+        ++failed;
+    }
+
+    // U+00E9 and U+1F600, the latter from a surrogate pair.
+    empdfer::JsonValue v = empdfer::parse_json(
+        "[\"\\u00e9\", \"\\uD83D\\uDE00\", 1.5e3, \"a\\\"b\"]");
+    if (v.array.size() != 4 || v.array[0].string != "\xc3\xa9" ||
+        v.array[1].string != "\xf0\x9f\x98\x80" ||
+        v.array[2].number != 1500. || v.array[3].string != "a\"b")
+    {
+        std::cerr << "wrong JSON values" << std::endl;
+        ++failed;
+    }
+    return failed;
+}
+
+int check_base64()
+{
+    int failed = 0;
+    std::vector<unsigned char> data;
+    for (unsigned size = 0; size < 20; ++size)
+    {
+        std::string text = empdfer::base64_encode(data.data(), data.size());
+        if (text.size() != (size + 2) / 3 * 4 ||
+            empdfer::base64_decode(text) != data)
+        {
+            std::cerr << size << " bytes: wrong base64 round trip" <<
+                std::endl;
+            ++failed;
+        }
+        data.push_back((unsigned char)(size * 97 + 200));
+    }
+
+    for (const char* text : {"YWJj$", "YQ===", "YQ=a", "Y"})
+    {
+        bool thrown = false;
+        try
+        {
+            empdfer::base64_decode(text);
+        }
+        catch (const std::exception&)
+        {
+            thrown = true;
+        }
+        if (!thrown)
+        {
+            std::cerr << text << ": decoded as base64" << std::endl;
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+std::string jpeg_base64()
+{
+    const unsigned width = 64, height = 48;
+    std::vector<unsigned char> gray(width * height);
+    for (unsigned i = 0; i < gray.size(); ++i)
+        gray[i] = (i % width) * 4;
+    std::vector<unsigned char> jpeg = empdfer::create_jpeg(
+        gray.data(), width, height, 1, JCS_GRAYSCALE, 75);
+    return empdfer::base64_encode(jpeg.data(), jpeg.size());
+}
+
+// Whether the answer is for the job with the given id, and, if ok, holds
+// a whole PDF document of one page.
+bool answered(const std::string& line, const std::string& id, bool ok)
+{
+    empdfer::JsonValue answer = empdfer::parse_json(line);
+    const empdfer::JsonValue* v = answer.find("id");
+    if (!v || empdfer::json_text(*v) != id)
+        return false;
+    v = answer.find("ok");
+    if (!v || v->type != empdfer::JsonValue::JSON_BOOLEAN || v->boolean != ok)
+        return false;
+    if (!ok)
+    {
+        v = answer.find("error");
+        return v && v->type == empdfer::JsonValue::JSON_STRING &&
+            !v->string.empty();
+    }
+
+    const empdfer::JsonValue* pages = answer.find("pages");
+    const empdfer::JsonValue* bytes = answer.find("bytes");
+    const empdfer::JsonValue* pdf = answer.find("pdf");
+    if (!pages || pages->number != 1 || !bytes || !pdf)
+        return false;
+    std::vector<unsigned char> data = empdfer::base64_decode(pdf->string);
+    std::string text(data.begin(), data.end());
+    return data.size() == bytes->number && text.compare(0, 5, "%PDF-") == 0 &&
+        text.find("%%EOF") != std::string::npos;
+}
+
+int check_serve()
+{
+    std::stringstream in;
+    in << "{\"id\": 1, \"pages\": [{\"data\": \"" << jpeg_base64() <<
+        "\"}]}\n"
+        "\n"
+        "{\"id\": \"two\", \"pages\": [{\"file\": \"no/such/file.jpg\"}]}\n"
+        "{\"id\": 3, \"pages\": [\n"
+        "{\"id\": 4, \"quality\": 101, \"pages\": []}\n";
+    std::stringstream out;
+    empdfer::serve(in, out, empdfer::ImageOptions(), NULL);
+
+    // An empty line gets no answer, and a request that is not valid JSON
+    // gets one without an id.
+    const std::string ids[] = {"1", "\"two\"", "null", "4"};
+    const bool oks[] = {true, false, false, false};
+    int failed = 0;
+    std::string line;
+    size_t i = 0;
+    for (; std::getline(out, line); ++i)
+        if (i >= 4 || !answered(line, ids[i], oks[i]))
+        {
+            std::cerr << "wrong answer: " << line.substr(0, 200) <<
+                std::endl;
+            ++failed;
+        }
+    if (i != 4)
+    {
+        std::cerr << i << " answers to 4 jobs" << std::endl;
+        ++failed;
+    }
+    return failed;
+}
+} // namespace
+
+int main()
+{
+    int failed = 0;
+    try
+    {
+        failed += check_parser();
+        failed += check_base64();
+        failed += check_serve();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        ++failed;
+    }
+    return failed;
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Runs a manifest of several documents, one of them with a page that
+// cannot be built, and checks that only that one is left out and that the
+// others are whole PDF documents.
+
+#include "jpeg_file.h"
+#include "json.h"
+#include "manifest.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<unsigned char> jpeg(unsigned shade)
+{
+    const unsigned width = 40, height = 30;
+    std::vector<unsigned char> rgb(width * height * 3);
+    for (size_t i = 0; i < rgb.size(); ++i)
+        rgb[i] = (unsigned char)(shade + i % 61);
+    return empdfer::create_jpeg(rgb.data(), width, height, 3, JCS_RGB, 75);
+}
+
+std::string read_file(const std::filesystem::path& path)
+{
+    std::ifstream f(path, std::ios_base::in|std::ios_base::binary);
+    return std::string(std::istreambuf_iterator<char>(f),
+                       std::istreambuf_iterator<char>());
+}
+
+// Whether the file is a PDF document of the given pages, with the cross
+// reference table where the trailer says it is.
+bool whole_pdf(const std::filesystem::path& path, unsigned pages)
+{
+    std::string pdf = read_file(path);
+    const std::string eof = "%%EOF\n";
+    size_t startxref = pdf.rfind("startxref\n");
+    if (pdf.compare(0, 5, "%PDF-") != 0 || pdf.size() < eof.size() ||
+        pdf.compare(pdf.size() - eof.size(), eof.size(), eof) != 0 ||
+        startxref == std::string::npos)
+        return false;
+    size_t xref = strtoul(pdf.c_str() + startxref + 10, NULL, 10);
+    return pdf.compare(xref, 5, "xref\n") == 0 &&
+        pdf.find("/Count " + std::to_string(pages) + " ") !=
+        std::string::npos;
+}
+
+std::string page_file(const std::filesystem::path& path)
+{
+    return "{\"file\": " + empdfer::json_string(path.string()) + "}";
+}
+
+std::string page_data(const std::vector<unsigned char>& data)
+{
+    return "{\"data\": \"" + empdfer::base64_encode(data.data(), data.size()) +
+        "\"}";
+}
+
+std::string job(const std::filesystem::path& output,
+                const std::vector<std::string>& pages)
+{
+    std::string line = "{\"output\": " +
+        empdfer::json_string(output.string()) + ", \"pages\": [";
+    for (size_t i = 0; i < pages.size(); ++i)
+        line += (i ? ", " : "") + pages[i];
+    return line + "]}\n";
+}
+
+bool check(const std::filesystem::path& dir, empdfer::ThreadPool* pool)
+{
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::filesystem::path image = dir / "a.jpg";
+    std::vector<unsigned char> a = jpeg(10);
+    std::ofstream(image, std::ios_base::out|std::ios_base::binary).write(
+        (const char*)a.data(), a.size());
+
+    // The bad document fails on its last page, after the first one has
+    // been written, and the documents around it must not notice.
+    std::vector<unsigned char> b = jpeg(100);
+    std::stringstream manifest;
+    manifest <<
+        job(dir / "good.pdf", {page_file(image), page_data(b)}) <<
+        job(dir / "bad.pdf", {page_data(b),
+                              page_file(dir / "missing.jpg")}) <<
+        job(dir / "other.pdf", {page_data(b), page_file(image),
+                                page_data(b)}) <<
+        "{\"pages\": [" << page_file(image) << "]}\n";
+
+    std::ostringstream errors;
+    size_t failed = empdfer::run_manifest(manifest, empdfer::ImageOptions(),
+                                          pool, errors);
+
+    bool ok = failed == 2 &&
+        errors.str().find("bad.pdf") != std::string::npos &&
+        errors.str().find("manifest line 4") != std::string::npos &&
+        !std::filesystem::exists(dir / "bad.pdf") &&
+        whole_pdf(dir / "good.pdf", 2) && whole_pdf(dir / "other.pdf", 3);
+    if (!ok)
+        std::cerr << errors.str();
+    return ok;
+}
+} // namespace
+
+int main()
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() /
+        ("empdfer_manifest_test_" + std::to_string(
+            std::chrono::system_clock::now().time_since_epoch().count()));
+    empdfer::ThreadPool pool(3);
+    int failed = 0;
+    for (empdfer::ThreadPool* p : {(empdfer::ThreadPool*)NULL, &pool})
+    {
+        bool ok = false;
+        try
+        {
+            ok = check(dir, p);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        if (!ok)
+        {
+            std::cerr << "manifest" << (p ? " on a pool" : "") <<
+                ": wrong documents" << std::endl;
+            ++failed;
+        }
+    }
+    std::filesystem::remove_all(dir);
+    return failed;
+}
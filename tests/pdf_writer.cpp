@@ -0,0 +1,221 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Streams pages, some of them showing the same image from different
+// inputs, and checks that each image is written once and that the cross
+// reference table gives the offset of every object.
+
+#include "create_page.h"
+#include "image.h"
+#include "jpeg_file.h"
+#include "pdf_writer.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef EMPDFER_USE_PNG
+#include <png.h>
+#endif
+
+namespace {
+const unsigned width = 40, height = 24;
+
+std::vector<unsigned char> jpeg(unsigned shade)
+{
+    std::vector<unsigned char> gray(width * height);
+    for (size_t i = 0; i < gray.size(); ++i)
+        gray[i] = (unsigned char)(shade + i % 53);
+    return empdfer::create_jpeg(gray.data(), width, height, 1, JCS_GRAYSCALE,
+                                75);
+}
+
+#ifdef EMPDFER_USE_PNG
+void append(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto out = (std::vector<unsigned char>*)png_get_io_ptr(png_ptr);
+    out->insert(out->end(), data, data + length);
+}
+
+// An RGB image with a gradient of transparency, which takes a soft mask.
+std::vector<unsigned char> rgba_png()
+{
+    std::vector<unsigned char> out;
+    png_structp png_ptr =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    png_set_write_fn(png_ptr, &out, append, NULL);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    std::vector<unsigned char> row(width * 4);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        for (unsigned x = 0; x < width; ++x)
+        {
+            row[4 * x] = x * 6;
+            row[4 * x + 1] = y * 10;
+            row[4 * x + 2] = 128;
+            row[4 * x + 3] = x * 255 / (width - 1);
+        }
+        png_write_row(png_ptr, row.data());
+    }
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return out;
+}
+#endif
+
+size_t occurrences(const std::string& text, const std::string& word)
+{
+    size_t n = 0;
+    for (size_t i = text.find(word); i != std::string::npos;
+         i = text.find(word, i + 1))
+        ++n;
+    return n;
+}
+
+// Whether the cross reference table the trailer points to has an entry
+// for each object, at the offset where the object begins.
+bool xref_matches(const std::string& pdf)
+{
+    size_t startxref = pdf.rfind("startxref\n");
+    if (startxref == std::string::npos)
+        return false;
+    size_t xref = strtoul(pdf.c_str() + startxref + 10, NULL, 10);
+    if (pdf.compare(xref, 7, "xref\n0 ") != 0)
+        return false;
+
+    char* end;
+    unsigned long size = strtoul(pdf.c_str() + xref + 7, &end, 10);
+    size_t entry = end - pdf.c_str() + 1;
+    if (size < 2 || *end != '\n' ||
+        pdf.compare(entry, 20, "0000000000 65535 f \n") != 0)
+        return false;
+
+    for (unsigned long object = 1; object < size; ++object)
+    {
+        entry += 20;
+        if (pdf.compare(entry + 10, 10, " 00000 n \n") != 0)
+            return false;
+        size_t offset = strtoul(pdf.c_str() + entry, NULL, 10);
+        std::string header = std::to_string(object) + " 0 obj\n";
+        if (pdf.compare(offset, header.size(), header) != 0)
+            return false;
+    }
+
+    // No object past those in the table.
+    return occurrences(pdf, " 0 obj\n") == size - 1 &&
+        pdf.compare(entry + 20, 8, "trailer\n") == 0;
+}
+
+// The image object each page shows, in order.
+std::vector<unsigned> page_images(const std::string& pdf)
+{
+    std::vector<unsigned> images;
+    const std::string name = "/XObject << /Im0 ";
+    for (size_t i = pdf.find(name); i != std::string::npos;
+         i = pdf.find(name, i + 1))
+        images.push_back(strtoul(pdf.c_str() + i + name.size(), NULL, 10));
+    return images;
+}
+
+bool check()
+{
+    std::vector<unsigned char> a = jpeg(10);
+    std::vector<unsigned char> a_copy = a;
+    std::vector<unsigned char> b = jpeg(90);
+
+    // Image a twice, and once more from a copy of its bytes under another
+    // name, and a different image.
+    std::vector<empdfer::Input> inputs = {
+        empdfer::Input("a.jpg", a.data(), a.size()),
+        empdfer::Input("copy of a.jpg", a_copy.data(), a_copy.size()),
+        empdfer::Input("b.jpg", b.data(), b.size()),
+        empdfer::Input("a.jpg", a.data(), a.size())};
+    // Pages showing the same image, which the writer must share.
+    std::vector<size_t> same = {0, 1, 3};
+    // Images, and soft masks, written.
+    size_t images = 2;
+    size_t masks = 0;
+
+#ifdef EMPDFER_USE_PNG
+    std::vector<unsigned char> c = rgba_png();
+    std::vector<unsigned char> c_copy = c;
+    inputs.push_back(empdfer::Input("c.png", c.data(), c.size()));
+    inputs.push_back(empdfer::Input("copy of c.png", c_copy.data(),
+                                    c_copy.size()));
+    images += 2;
+    masks += 1;
+#endif
+
+    empdfer::ImageOptions options;
+    options.embed_flate = true;
+    std::ostringstream out;
+    empdfer::PdfWriter w(out);
+    for (const empdfer::Input& input : inputs)
+    {
+        empdfer::PageImage p = empdfer::create_page(input, options);
+        empdfer::deflate_image(p.image, options);
+        empdfer::digest_image(p.image);
+        w.write_page(p);
+    }
+    w.finish();
+
+    std::string pdf = out.str();
+    std::vector<unsigned> shown = page_images(pdf);
+    if (shown.size() != inputs.size())
+        return false;
+    for (size_t i : same)
+        if (shown[i] != shown[same[0]])
+            return false;
+    if (shown[2] == shown[0])
+        return false;
+#ifdef EMPDFER_USE_PNG
+    if (shown[4] != shown[5] || shown[4] == shown[0] || shown[4] == shown[2])
+        return false;
+#endif
+
+    return occurrences(pdf, "/Subtype /Image") == images &&
+        occurrences(pdf, "/SMask ") == masks && xref_matches(pdf);
+}
+} // namespace
+
+int main()
+{
+    bool ok = false;
+    try
+    {
+        ok = check();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    if (!ok)
+    {
+        std::cerr << "streamed document: images written more than once or "
+            "wrong cross reference table" << std::endl;
+        return 1;
+    }
+    return 0;
+}
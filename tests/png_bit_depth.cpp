@@ -0,0 +1,136 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+// Encodes gray PNG images with 1, 2 and 4 bits per sample as JPEG, which
+// takes their samples expanded to 8 bits, and checks the pixels survive.
+
+#include "image.h"
+#include "jpeg_file.h"
+#include "png_file.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+namespace {
+// Level of the sample at (x, y), from 0 to 2^bits - 1.
+unsigned level(unsigned x, unsigned y, unsigned bits)
+{
+    return (x / 37 + y / 23) % (1u << bits);
+}
+
+void append(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto out = (std::vector<unsigned char>*)png_get_io_ptr(png_ptr);
+    out->insert(out->end(), data, data + length);
+}
+
+std::vector<unsigned char> gray_png(unsigned width, unsigned height,
+                                    unsigned bits, bool interlaced)
+{
+    std::vector<unsigned char> out;
+    png_structp png_ptr =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    png_set_write_fn(png_ptr, &out, append, NULL);
+    png_set_IHDR(png_ptr, info_ptr, width, height, bits, PNG_COLOR_TYPE_GRAY,
+                 interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    png_set_interlace_handling(png_ptr);
+
+    size_t row_bytes = (width * bits + 7) / 8;
+    std::vector<unsigned char> image(row_bytes * height);
+    std::vector<png_bytep> rows(height);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        rows[y] = image.data() + y * row_bytes;
+        for (unsigned x = 0; x < width; ++x)
+            rows[y][x * bits / 8] |=
+                level(x, y, bits) << (8 - bits - x * bits % 8);
+    }
+
+    png_write_image(png_ptr, rows.data());
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return out;
+}
+
+// Whether the image, encoded as JPEG from a PNG file, looks like the one
+// in the file.
+bool check(unsigned bits, bool interlaced)
+{
+    const unsigned width = 301, height = 203;
+    std::vector<unsigned char> png = gray_png(width, height, bits,
+                                              interlaced);
+
+    empdfer::Input input("gray.png");
+    input.data = png.data();
+    input.size = png.size();
+
+    empdfer::ImageOptions options;
+    options.quality = 90;
+    empdfer::ImageInfo info = empdfer::probe_png(input);
+    empdfer::PageImage p = empdfer::png_page(input, info, options);
+
+    empdfer::Input jpeg("gray.jpg");
+    jpeg.data = p.image.data.data();
+    jpeg.size = p.image.data.size();
+    empdfer::Pixels pixels = empdfer::decode_jpeg(jpeg);
+    if (pixels.width != width || pixels.height != height ||
+        pixels.components != 1)
+        return false;
+
+    double error = 0.;
+    unsigned max = (1u << bits) - 1;
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+            error += std::abs((int)pixels.data[y * width + x] -
+                              (int)(level(x, y, bits) * 255 / max));
+    return error / (width * height) < 4.;
+}
+} // namespace
+
+int main()
+{
+    int failed = 0;
+    for (unsigned bits : {1, 2, 4})
+        for (bool interlaced : {false, true})
+        {
+            bool ok = false;
+            try
+            {
+                ok = check(bits, interlaced);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            if (!ok)
+            {
+                std::cerr << bits << "-bit" <<
+                    (interlaced ? " interlaced" : "") <<
+                    " gray PNG: wrong JPEG pixels" << std::endl;
+                ++failed;
+            }
+        }
+    return failed;
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2026 Luis Peñaranda. All rights reserved.
+//
+// This file is part of empdfer.
+//
+// Empdfer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Empdfer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with empdfer.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EMPDFER_THREAD_POOL_H
+#define EMPDFER_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "stats.h"
+
+namespace empdfer {
+
+// A fixed set of worker threads that run submitted tasks in FIFO order.
+// Results (and exceptions) are handed back through the returned future.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned workers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return workers_.size(); }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f)
+    {
+        typedef std::invoke_result_t<F> R;
+        auto task =
+            std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push([task]() { (*task)(); });
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+private:
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// Number of workers to use when the user asks for "all cores".
+unsigned hardware_jobs();
+
+// Runs produce(i) for every i in [0, n) on the pool and passes the results
+// to consume() on the calling thread, in index order. At most window
+// results are pending at any time. Without a pool, everything runs on the
+// calling thread.
+template <typename P, typename C>
+void ordered_for_each(ThreadPool* pool, size_t n, size_t window, P produce,
+                      C consume)
+{
+    if (pool == NULL)
+    {
+        for (size_t i = 0; i < n; ++i)
+            consume(produce(i));
+        return;
+    }
+
+    typedef std::invoke_result_t<P, size_t> R;
+    std::deque<std::future<R>> pending;
+    size_t next = 0;
+
+    try
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (; next < n && pending.size() < std::max<size_t>(window, 1);
+                 ++next)
+                pending.push_back(
+                    pool->submit([&produce, next]() { return produce(next); }));
+
+            R result = pending.front().get();
+            pending.pop_front();
+            consume(std::move(result));
+        }
+    }
+    catch (...)
+    {
+        // The pending tasks refer to produce, let them finish before it
+        // goes away.
+        for (auto& f : pending)
+            if (f.valid())
+                f.wait();
+        throw;
+    }
+}
+
+// Runs f(i) for every i in [0, n), in no particular order, on the calling
+// thread and on the workers of the pool that are free to help, and returns
+// once all are done. The calling thread takes whatever the workers do not,
+// so it can itself be a task of the pool. The first exception thrown by f
+// is thrown again once the other calls are over. What the calls record is
+// added to the stats of the calling thread.
+template <typename F>
+void parallel_for(ThreadPool* pool, size_t n, F f)
+{
+    // Shared with the helpers, which may only start once everything is
+    // done and there is nothing left for them.
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t next = 0;
+        size_t finished = 0;
+        size_t n;
+        F* f;
+        Stats* stats;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->n = n;
+    state->f = &f;
+    state->stats = active_stats();
+
+    auto work = [](State& s)
+    {
+        while (true)
+        {
+            size_t i;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (s.next == s.n)
+                    return;
+                i = s.next++;
+            }
+
+            // Each call records on its own, the threads would race on
+            // the shared stats otherwise.
+            Stats stats;
+            std::exception_ptr error;
+            try
+            {
+                StatsScope scope(s.stats ? &stats : NULL);
+                (*s.f)(i);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.stats)
+                s.stats->add(stats);
+            if (error && !s.error)
+                s.error = error;
+            if (++s.finished == s.n)
+                s.done.notify_all();
+        }
+    };
+
+    if (pool)
+        for (size_t k = 1; k < std::min<size_t>(n, pool->size() + 1); ++k)
+            pool->submit([state, work]() { work(*state); });
+
+    work(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->finished == n; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+} // namespace empdfer
+
+#endif // EMPDFER_THREAD_POOL_H